@@ -19,31 +19,32 @@
 #define STRAIGHT_RGB
 
 #include "ws2811/ws2811.h"
+#include "../led_index_type.hpp"
 
 namespace {
-    const uint8_t led_count = 50;
+    const uint16_t led_count = 50;
     const uint8_t channel = 4;
 
     /**
-     * Not the fastest way to calculate this, but for about 8 iterations at compile time, this will do.
+     * Not the fastest way to calculate this, but for about 16 iterations at compile time, this will do.
      *
      * This is used to find the lowest power of two that is equal or larger than the number of LEDs at
      * compilation time.
      */
-    template<uint8_t number, uint8_t guess = 1, bool fits = guess >= number>
+    template<uint16_t number, uint32_t guess = 1, bool fits = guess >= number>
     struct lowest_power_of_2
     {
-        static const uint8_t value = lowest_power_of_2<number, 2 * guess>::value;
+        static const uint32_t value = lowest_power_of_2<number, 2 * guess>::value;
     };
 
-    template< uint8_t number, uint8_t guess>
+    template< uint16_t number, uint32_t guess>
     struct lowest_power_of_2<number, guess, true>
     {
-        static const uint8_t value = guess;
+        static const uint32_t value = guess;
     };
 
-    template< typename buffer_type>
-    void write_block( buffer_type &leds, uint8_t &offset, uint8_t end_offset, uint8_t size, const ws2811::rgb &color)
+    template< typename buffer_type, typename index_type>
+    void write_block( buffer_type &leds, index_type &offset, index_type end_offset, index_type size, const ws2811::rgb &color)
     {
         while (size-- && offset != end_offset)
         {
@@ -77,15 +78,16 @@ namespace {
     template< typename buffer_type>
     void binary_pattern( buffer_type &leds, uint8_t channel)
     {
+        typedef typename led_index_type<ws2811::led_buffer_traits<buffer_type>::count>::type index_type;
         static const uint8_t frame_delay = 100; // in ms;
-        static const uint8_t number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
-        uint8_t block_size = lowest_power_of_2<number_of_leds>::value/2;
+        static const index_type number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
+        index_type block_size = lowest_power_of_2<number_of_leds>::value/2;
         using ws2811::rgb;
 
         while (block_size)
         {
             // write binary pattern.
-            uint8_t current_led = 0;
+            index_type current_led = 0;
 
             while (current_led < number_of_leds)
             {
@@ -107,11 +109,12 @@ namespace {
     template< typename buffer_type>
     void registration_pattern( buffer_type &leds, uint8_t channel)
     {
-        static const uint8_t frame_delay_ms = 2000; // in ms;
-        static const uint8_t number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
+        typedef typename led_index_type<ws2811::led_buffer_traits<buffer_type>::count>::type index_type;
+        static const uint16_t frame_delay_ms = 2000; // in ms;
+        static const index_type number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
         using ws2811::rgb;
 
-        uint8_t current_led = 0;
+        index_type current_led = 0;
         for (uint8_t count = 4; count; --count)
         {
             current_led = 0;
@@ -136,7 +139,8 @@ namespace {
     void simple_registration( buffer_type &leds, uint8_t channel, const ws2811::rgb &color)
     {
 
-        static const uint8_t number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
+        typedef typename led_index_type<ws2811::led_buffer_traits<buffer_type>::count>::type index_type;
+        static const index_type number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
         static const uint8_t frame_delay_ms = 100; // in ms;
 
         fill( leds, color);
@@ -146,7 +150,7 @@ namespace {
         send( leds, channel);
         _delay_ms( 2* frame_delay_ms);
 
-        for (uint8_t count = 0; count < number_of_leds; ++count)
+        for (index_type count = 0; count < number_of_leds; ++count)
         {
 
             clear( leds);
@@ -161,6 +165,45 @@ namespace {
         clear( leds);
         send( leds, channel);
     }
+
+    /**
+     * Flash the LEDs three at a time: one pure red, one pure green and one pure blue LED per frame.
+     *
+     * The camera sees the three colours on separate channels, so the host can tell the three LEDs
+     * apart (LedMapping --sequence=color). This takes a third of the frames of simple_registration().
+     */
+    template< typename buffer_type>
+    void color_registration( buffer_type &leds, uint8_t channel, uint8_t brightness)
+    {
+        typedef typename led_index_type<ws2811::led_buffer_traits<buffer_type>::count>::type index_type;
+        static const index_type number_of_leds = ws2811::led_buffer_traits<buffer_type>::count;
+        static const uint8_t frame_delay_ms = 100; // in ms;
+        using ws2811::rgb;
+
+        fill( leds, rgb( brightness, brightness, brightness));
+        send( leds, channel);
+        _delay_ms( 2*frame_delay_ms);
+        clear( leds);
+        send( leds, channel);
+        _delay_ms( 2* frame_delay_ms);
+
+        // count stays a multiple of 3, so it stops at 255 at the latest and does not wrap for 8-bit indices.
+        for (index_type count = 0; count < number_of_leds; count += 3)
+        {
+            clear( leds);
+            get( leds, count) = rgb( brightness, 0, 0);
+            if (count + 1 < number_of_leds) get( leds, count + 1) = rgb( 0, brightness, 0);
+            if (count + 2 < number_of_leds) get( leds, count + 2) = rgb( 0, 0, brightness);
+            send( leds, channel);
+            _delay_ms( frame_delay_ms);
+
+            clear( leds);
+            send( leds, channel);
+            _delay_ms( frame_delay_ms);
+        }
+        clear( leds);
+        send( leds, channel);
+    }
 }
 
 ws2811::rgb leds[led_count];
@@ -172,6 +215,7 @@ int main()
     for(;;)
     {
         simple_registration( leds, channel, ws2811::rgb( 16, 0, 0));
+        // color_registration( leds, channel, 16); // decode with LedMapping --sequence=color
         _delay_ms( 2000);
     }
 
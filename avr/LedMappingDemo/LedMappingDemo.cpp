@@ -23,319 +23,83 @@
 #define STRAIGHT_RGB
 
 #include <ws2811/ws2811.h>
+#include "position.hpp"
+#include "led_positions.hpp"
+#include "ball.hpp"
+#include "frame_scheduler.hpp"
 
 serial::uart<> uart( 19200);
 
 IMPLEMENT_UART_INTERRUPT(uart);
+IMPLEMENT_FRAME_CLOCK_INTERRUPT();
 PIN_TYPE( B, 0) movement_detector;
 
 namespace {
     const uint8_t channel = 4;
 
-    template<typename CoordinateType>
-    struct Position {
-//        Position( CoordinateType x, CoordinateType y)
-//        :x(x), y(y)
-//        {}
+    using led_positions::distances0;
+    using led_positions::distances1;
 
-        CoordinateType x;
-        CoordinateType y;
-    };
-
-    template<typename CoordinateType>
-    struct Size
-    {
-//        Size( CoordinateType width, CoordinateType height)
-//        : width( width), height( height)
-//        {}
-
-        CoordinateType width;
-        CoordinateType height;
-    };
-
-
-    typedef Position<uint8_t>   Position8;
-    typedef Position<uint16_t>  Position16; // position in 8.8 fixed point
-    typedef Size<uint8_t>       Size8;
-    typedef Size<uint16_t>      Size16;
-
-    template<typename buffer, uint8_t shade_count = 4>
-    class ball
-    {
-    public:
-        ball( Position8 position, Size8 size)
-        : m_position( position), m_size(size)
-        {
-
-        }
-
-        void draw(
-                buffer &leds,
-                const Position8 (&pos)[ws2811::led_buffer_traits<buffer>::count],
-                const ws2811::rgb (&shades)[shade_count])
-        {
-            // for each LED we know
-            for (uint16_t count = 0; count < m_count; ++count)
-            {
-                // if the LED is within the bounding box of our shape.
-                if ( absolute_difference( pos[count].x, m_position.x) < m_size.width
-                     and absolute_difference( pos[count].y, m_position.y) < m_size.height)
-                {
-                    // calculate if it is within the ellipse.
-                    uint16_t dist = square_distance( pos[count]);
-                    if (dist < 256)
-                    {
-                        uint8_t index = (dist * shade_count) >> 8;
-                        leds[count] = shades[index];
-                    }
-                }
-            }
-        }
-
-    private:
-        static const uint16_t m_count = ws2811::led_buffer_traits<buffer>::count;
-        Position8   m_position;
-        Size8       m_size;
-
-        static uint16_t absolute_difference( uint8_t left, uint8_t right)
-        {
-            if (left > right) return left - right;
-            else return right - left;
-        }
-
-        /**
-         * Return a number >= 256 if the given point is outside the ellipse, but if the given point is inside the ellipse
-         * return a number between 0 and 255 that indicates how close the point is to the center (0) or the edge (255) of the ellipse
-         *
-         */
-        uint16_t square_distance( const Position8 &pos)
-        {
-            Size16 distance = {
-                    absolute_difference( pos.x, m_position.x) << 8,
-                    absolute_difference( pos.y, m_position.y) << 8
-            };
-
-            distance.width /= m_size.width;
-            distance.height /= m_size.height;
-
-            if (distance.width < 256 && distance.height < 256)
-            {
-                return ((distance.width * distance.width) >> 8) + ((distance.height * distance.height) >> 8);
-            }
-            else
-            {
-                return 256;
-            }
-        }
+    /**
+     * The LED positions and distance tables in led_positions.hpp are generated by LedMapping --header and
+     * live in program memory.
+     */
+    const uint16_t led_count = led_positions::led_count;
 
-    };
+    /**
+     * The effects send their frames at this fixed rate, which leaves at least half of each frame for drawing.
+     */
+    const uint16_t frames_per_second = frame_rate<led_count>::value;
 
     /**
-     * These are hard-coded LED positions that were obtained by running the LedMapping OpenCV registry algorithm.
+     * fade() used to send a frame and then wait 2ms, 512 times. It runs at the rate that keeps that duration.
      */
-    const Position8 pos[] = {
-            { 2, 102},
-            { 55, 95},
-            { 73, 80},
-            { 121, 73},
-            { 94, 56},
-            { 40, 56},
-            { 0, 45},
-            { 41, 34},
-            { 19, 17},
-            { 50, 3},
-            { 109, 2},
-            { 171, 0},
-            { 205, 14},
-            { 174, 30},
-            { 223, 39},
-            { 239, 56},
-            { 212, 69},
-            { 178, 82},
-            { 211, 93},
-            { 186, 107},
-            { 239, 114},
-            { 246, 132},
-            { 197, 144},
-            { 145, 137},
-            { 150, 119},
-            { 114, 107},
-            { 63, 118},
-            { 36, 134},
-            { 95, 141},
-            { 103, 158},
-            { 41, 156},
-            { 18, 172},
-            { 75, 175},
-            { 129, 182},
-            { 171, 168},
-            { 224, 159},
-            { 246, 176},
-            { 255, 196},
-            { 212, 209},
-            { 151, 204},
-            { 89, 202},
-            { 32, 211},
-            { 86, 222},
-            { 149, 226},
-            { 214, 227},
-            { 230, 240},
-            { 171, 247},
-            { 110, 255},
-            { 77, 241},
-            { 18, 241}
-    };
-
-
-    const uint8_t led_count = sizeof pos/ sizeof pos[0];
+    const uint16_t fade_frames_per_second = 1000000UL / (2000 + 30UL * led_count);
 
 
 
 using ws2811::rgb;
 
-void animate(Position8& p1, Size8 s, Position8& v1)
+template<typename coordinate_type>
+void animate(Position<coordinate_type>& p1, Size<coordinate_type> s, Position<coordinate_type>& v1)
 {
+    static const coordinate_type max = static_cast<coordinate_type>( -1);
     p1.x += v1.x;
     p1.y += v1.y;
-    if (p1.y < s.height / 2 || p1.y > 255 - s.height / 2)
+    if (p1.y < s.height / 2 || p1.y > max - s.height / 2)
     {
         v1.y = -v1.y;
     }
-    if (p1.x < s.width / 2 || p1.x > 255 - s.width / 2)
+    if (p1.x < s.width / 2 || p1.x > max - s.width / 2)
     {
         v1.x = -v1.x;
     }
 }
 
 template< typename buffer_type, int shade_count>
-void bouncing_ball( buffer_type &buffer, const rgb (&fades)[shade_count])
+void bouncing_ball( buffer_type &leds, const rgb (&fades)[shade_count])
 {
-    Position8 p1 = {128,128};
-    Position8 v1 = { 3, 2};
-    Size8 s = {120, 36};
+    frame_scheduler<buffer_type, frames_per_second> frames( leds, channel);
+    // the index of long strings has 8.8 fixed point positions, coordinates in 0..255 are scaled to match.
+    typedef typename led_positions::index_table::coordinate coordinate_type;
+    const uint16_t scale = sizeof( coordinate_type) == 1 ? 1 : 256;
+    Position<coordinate_type> p1 = { static_cast<coordinate_type>( 128U * scale), static_cast<coordinate_type>( 128U * scale)};
+    Position<coordinate_type> v1 = { static_cast<coordinate_type>( 3U * scale), static_cast<coordinate_type>( 2U * scale)};
+    Size<coordinate_type> s = { static_cast<coordinate_type>( 120U * scale), static_cast<coordinate_type>( 36U * scale)};
     for(;;)
     {
-        ball<buffer_type, shade_count> b1( p1, s);
+        ball<buffer_type, shade_count, coordinate_type> b1( p1, s);
 
 
-        fill( buffer, rgb(10, 10, 10));
-        b1.draw( buffer, pos, fades);
+        fill( leds, rgb(10, 10, 10));
+        b1.draw( leds, led_positions::index, fades);
 
-        send( buffer, channel);
-        _delay_ms( 5);
+        frames.show();
 
         animate( p1, s, v1);
     }
 }
 
-const uint8_t distances2[] =
-{
-        46,
-        66,
-        96,
-        120,
-        141,
-        133,
-        152,
-        175,
-        205,
-        233,
-        239,
-        255,
-        237,
-        205,
-        205,
-        185,
-        158,
-        128,
-        131,
-        108,
-        133,
-        134,
-        112,
-        81,
-        83,
-        72,
-        38,
-        24,
-        58,
-        81,
-        58,
-        85,
-        97,
-        124,
-        121,
-        136,
-        162,
-        189,
-        192,
-        166,
-        148,
-        157,
-        182,
-        201,
-        220,
-        245,
-        242,
-        245,
-        217,
-        213
-};
-
-// distances from the center point.
-const uint8_t distances[] = {
-        88,
-        76,
-        99,
-        107,
-        141,
-        149,
-        179,
-        192,
-        228,
-        251,
-        248,
-        255,
-        228,
-        196,
-        185,
-        155,
-        124,
-        94,
-        83,
-        52,
-        70,
-        69,
-        52,
-        22,
-        20,
-        39,
-        41,
-        55,
-        33,
-        63,
-        76,
-        110,
-        99,
-        109,
-        86,
-        85,
-        120,
-        156,
-        171,
-        155,
-        152,
-        176,
-        190,
-        197,
-        206,
-        233,
-        240,
-        254,
-        230,
-        236
-};
-
 const uint8_t PROGMEM gamma8[] = {
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,
     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  1,  1,  1,  1,
@@ -372,7 +136,7 @@ uint8_t scale( int8_t lhs, uint8_t rhs)
 }
 
 /**
- * Send LED data to an LED string while switching off interrupts.
+ * Send LED data to an LED string while switching off interrupts, for frames that are not sent by a frame_scheduler.
  */
 template< typename buffer>
 void send_protected( const buffer &b, uint8_t channel)
@@ -383,8 +147,9 @@ void send_protected( const buffer &b, uint8_t channel)
 }
 
 template< typename buffer_type, uint16_t shade_count>
-void ripples( buffer_type &buffer, const rgb (&fades)[shade_count])
+void ripples( buffer_type &leds, const rgb (&fades)[shade_count])
 {
+    frame_scheduler<buffer_type, frames_per_second> frames( leds, channel);
     PIN_TYPE( B, 0) detector;
     set( detector);
     make_input( detector);
@@ -396,22 +161,22 @@ void ripples( buffer_type &buffer, const rgb (&fades)[shade_count])
 //    const auto ambient_color = rgb{0,0,0};
     for(;;)
     {
-        fill( buffer, ambient_color);
-        send(buffer, channel);
+        fill( leds, ambient_color);
+        frames.show();
         while (not is_set( detector))
         {
         }
+        frames.resync();
 
         for (uint16_t time = 2000; time; --time)
         {
             for (uint16_t count = 0; count < led_count; ++count)
             {
-                get( buffer, count) = fades[ (static_cast<uint16_t>(distances2[count]) - offset) % shade_count];
+                get( leds, count) = fades[ (static_cast<uint16_t>( pgm_read_byte( &distances1[count])) - offset) % shade_count];
             }
-            send( buffer, channel);
+            frames.show();
             ++offset;
             if (offset == shade_count) offset = 0;
-            _delay_ms( 4);
         }
     }
 }
@@ -420,14 +185,16 @@ template< typename buffer_type>
 void fade( buffer_type &leds, bool in = true)
 {
     constexpr auto led_count = ws2811::led_buffer_traits<buffer_type>::count;
+    typedef typename led_index_type<led_count>::type index_type;
     const auto base_color = in?rgb( 0,0,0):rgb( 255, 255, 255);
+    frame_scheduler<buffer_type, fade_frames_per_second> frames( leds, channel);
 
     for (uint16_t count = 0; count < 512; ++count)
     {
         fill( leds, base_color);
-        for ( uint8_t led = 0; led < led_count; ++led)
+        for ( index_type led = 0; led < led_count; ++led)
         {
-            const uint8_t distance = distances[led];
+            const uint8_t distance = pgm_read_byte( &distances0[led]);
             if (distance <= count)
             {
                 uint16_t offset = count-distance;
@@ -440,8 +207,7 @@ void fade( buffer_type &leds, bool in = true)
                 get( leds, led) = rgb( br, br, br);
             }
         }
-        send_protected( leds, channel);
-        _delay_ms( 2);
+        frames.show();
     }
 }
 
@@ -476,9 +242,11 @@ void watch()
     using esp_link::mqtt::setup;
     using esp_link::mqtt::publish;
     const char topic[] = "spider/switch/0";
+    const char overruns_topic[] = "spider/overruns";
+    char overruns[6];
 
     fill( leds, rgb( 0, 5, 5));
-    send( leds, channel);
+    send_protected( leds, channel);
 
     // get startup logging of the uart out of the way.
     _delay_ms( 2000);     // wait for an eternity.
@@ -498,6 +266,10 @@ void watch()
 
         wait_for_non_movement();
         fade( leds, false); // fade out
+
+        // report the number of frames that were drawn too late so far.
+        utoa( frame_clock::overruns, overruns, 10);
+        esp.execute( publish, overruns_topic, overruns, 0, 0);
     }
 }
 
@@ -0,0 +1,199 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#if !defined( BALL_HPP_)
+#define BALL_HPP_
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "position.hpp"
+
+// ws2811.h must have been included before this file, after defining WS2811_PORT.
+
+/**
+ * Computes (difference * 256) / size for a difference smaller than size, without a general division.
+ */
+template<typename coordinate_type>
+class distance_scale;
+
+/**
+ * For 8-bit coordinates, the division is replaced by a multiplication with a reciprocal that is computed once.
+ *
+ * (difference * 256) / size is computed as (difference * reciprocal) / 65536, which is exact for 8-bit differences
+ * and sizes: the rounding error of the reciprocal adds less than 255/65536, and the fraction that it is added to is
+ * at most 1 - 1/255.
+ */
+template<>
+class distance_scale<uint8_t>
+{
+public:
+    explicit distance_scale( uint8_t size)
+    : m_reciprocal( size ? (16777216UL + size - 1) / size : 0) // 2^24 / size, rounded up
+    {
+    }
+
+    uint16_t operator()( uint8_t difference) const
+    {
+        return (difference * m_reciprocal) >> 16;
+    }
+
+private:
+    uint32_t m_reciprocal;
+};
+
+/**
+ * For 16-bit (8.8 fixed point) coordinates, a reciprocal would need a 64-bit product to be exact. Because the
+ * difference is smaller than the size, the result has only 8 bits, and those are computed with 8 steps of a
+ * shift-and-subtract division, which is exact and much cheaper than a full 32/16 bit division.
+ */
+template<>
+class distance_scale<uint16_t>
+{
+public:
+    explicit distance_scale( uint16_t size)
+    : m_size( size)
+    {
+    }
+
+    uint16_t operator()( uint16_t difference) const
+    {
+        if (difference >= m_size) return 256;
+
+        uint32_t remainder = difference;
+        uint8_t quotient = 0;
+        for (uint8_t bit = 0; bit < 8; ++bit)
+        {
+            remainder <<= 1;
+            const bool fits = remainder >= m_size;
+            if (fits) remainder -= m_size;
+            quotient = (quotient << 1) | fits;
+        }
+        return quotient;
+    }
+
+private:
+    uint16_t m_size;
+};
+
+/**
+ * An elliptic, shaded blob that is drawn onto the LEDs that fall inside it.
+ *
+ * draw() only visits the LEDs whose x-coordinate is within the bounding box of the ellipse, using the x-sorted index
+ * of the LED positions (see led_index), and the divisions by the size of the ellipse are replaced by the cheaper
+ * distance_scale. When the bounding box spans most of the LEDs, draw() goes through the positions in LED order instead,
+ * which is cheaper than looking up every LED in the index.
+ *
+ * The coordinates are either 8 bits (Position8, 0..255) or 8.8 fixed point (Position16), which keeps LEDs that are
+ * close together apart in strings of more than 255 LEDs.
+ */
+template<typename buffer, uint8_t shade_count = 4, typename coordinate_type = uint8_t>
+class ball
+{
+public:
+    typedef Position<coordinate_type> position_type;
+    typedef Size<coordinate_type> size_type;
+    typedef typename led_index_type<ws2811::led_buffer_traits<buffer>::count>::type index_type;
+
+    ball( position_type position, size_type size)
+    : m_position( position), m_size(size), m_scale_width( size.width), m_scale_height( size.height)
+    {
+    }
+
+    void draw(
+            buffer &leds,
+            const led_index<index_type, coordinate_type> &index,
+            const ws2811::rgb (&shades)[shade_count])
+    {
+        static const coordinate_type max = static_cast<coordinate_type>( -1);
+
+        // x-range of the bounding box of our shape.
+        const coordinate_type left = m_position.x >= m_size.width ? m_position.x - m_size.width + 1 : 0;
+        const coordinate_type right = max - m_position.x >= m_size.width ? m_position.x + m_size.width - 1 : max;
+        if (not m_size.width or left > right) return;
+
+        const index_type first = read_index( index.x_cells, x_cell( left));
+        const index_type last = read_index( index.x_cells, x_cell( right) + 1);
+        if (last - first > index.count / 2)
+        {
+            // the x-range holds most of the LEDs, going through x_order would only add an indirection per LED.
+            for (index_type led = 0; led < index.count; ++led)
+            {
+                const position_type pos = read_position( index.positions, led);
+                if (pos.x >= left and pos.x <= right)
+                {
+                    draw_led( leds, led, pos, shades);
+                }
+            }
+            return;
+        }
+
+        // visit the LEDs in x-order, starting at the first LED of the cell that contains 'left'.
+        for (index_type entry = first; entry < last; ++entry)
+        {
+            const index_type led = read_index( index.x_order, entry);
+            const position_type pos = read_position( index.positions, led);
+            if (pos.x > right) break;
+
+            if (pos.x >= left)
+            {
+                draw_led( leds, led, pos, shades);
+            }
+        }
+    }
+
+private:
+    position_type   m_position;
+    size_type       m_size;
+    distance_scale<coordinate_type> m_scale_width;
+    distance_scale<coordinate_type> m_scale_height;
+
+    /**
+     * Draw the LED at 'pos', which is in the x-range of our shape, if it is also inside the ellipse.
+     */
+    void draw_led( buffer &leds, index_type led, const position_type &pos, const ws2811::rgb (&shades)[shade_count])
+    {
+        // the y-range is tested first, to skip the distance computation for most LEDs outside our shape.
+        if (absolute_difference( pos.y, m_position.y) < m_size.height)
+        {
+            // calculate if it is within the ellipse.
+            uint16_t dist = square_distance( pos);
+            if (dist < 256)
+            {
+                uint8_t shade = (dist * shade_count) >> 8;
+                leds[led] = shades[shade];
+            }
+        }
+    }
+
+    static coordinate_type absolute_difference( coordinate_type left, coordinate_type right)
+    {
+        if (left > right) return left - right;
+        else return right - left;
+    }
+
+    /**
+     * Return a number >= 256 if the given point is outside the ellipse, but if the given point is inside the ellipse
+     * return a number between 0 and 255 that indicates how close the point is to the center (0) or the edge (255) of the ellipse
+     */
+    uint16_t square_distance( const position_type &pos)
+    {
+        Size16 distance = {
+                m_scale_width( absolute_difference( pos.x, m_position.x)),
+                m_scale_height( absolute_difference( pos.y, m_position.y))
+        };
+
+        if (distance.width < 256 && distance.height < 256)
+        {
+            return ((distance.width * distance.width) >> 8) + ((distance.height * distance.height) >> 8);
+        }
+        else
+        {
+            return 256;
+        }
+    }
+};
+
+#endif //BALL_HPP_
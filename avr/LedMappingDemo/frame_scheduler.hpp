@@ -0,0 +1,144 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#if !defined( FRAME_SCHEDULER_HPP_)
+#define FRAME_SCHEDULER_HPP_
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// ws2811.h must have been included before this file, after defining WS2811_PORT.
+
+/**
+ * Frame clock, driven by timer 1 in CTC mode.
+ *
+ * The timer interrupt only counts ticks, the LED data is sent from the main loop (see frame_scheduler). Exactly one
+ * translation unit must contain IMPLEMENT_FRAME_CLOCK_INTERRUPT(), which defines the interrupt routine and the
+ * counters.
+ */
+struct frame_clock
+{
+    /// Number of timer periods since start(), modulo 256.
+    static volatile uint8_t ticks;
+
+    /// Number of frame periods that were skipped because a frame was not drawn in time, over all effects.
+    static uint16_t overruns;
+
+    static const uint16_t prescaler = 64;
+
+    /**
+     * Start the timer with a period of 1/frames_per_second seconds.
+     */
+    template<uint16_t frames_per_second>
+    static void start()
+    {
+        static_assert( F_CPU / prescaler / frames_per_second - 1 <= 0xffff, "frame rate too low for timer 1");
+        static_assert( F_CPU / prescaler / frames_per_second > 1, "frame rate too high for timer 1");
+
+        TCCR1A = 0;
+        TCCR1B = _BV( WGM12) | _BV( CS11) | _BV( CS10); // CTC on OCR1A, clk/64
+        OCR1A = F_CPU / prescaler / frames_per_second - 1;
+        TCNT1 = 0;
+        TIMSK1 |= _BV( OCIE1A);
+        sei();
+    }
+
+    static void stop()
+    {
+        TIMSK1 &= ~_BV( OCIE1A);
+        TCCR1B = 0;
+    }
+};
+
+#define IMPLEMENT_FRAME_CLOCK_INTERRUPT() \
+    volatile uint8_t frame_clock::ticks = 0; \
+    uint16_t frame_clock::overruns = 0; \
+    ISR( TIMER1_COMPA_vect) \
+    { \
+        ++frame_clock::ticks; \
+    } \
+    /**/
+
+/**
+ * The highest frame rate, up to 200 frames per second, at which sending 'led_count' LEDs takes at most half of the
+ * frame period, leaving the other half for drawing. A WS2811 LED takes 30us to send.
+ */
+template<uint16_t led_count>
+struct frame_rate
+{
+    static const uint32_t send_us = 30UL * led_count;
+    static const uint16_t value = 2 * send_us < 1000000UL / 200 ? 200 : 1000000UL / (2 * send_us);
+};
+
+/**
+ * Sends LED frames at a fixed rate.
+ *
+ * An effect draws a frame into its buffer and calls show(). show() waits for the next tick of the frame clock and
+ * sends the buffer right away, so that every frame starts at a tick, independent of how long drawing took. The LEDs
+ * latch the data that was sent, so the effect can draw the next frame into the same buffer while the LEDs show the
+ * current one; a second buffer would not add any overlap.
+ *
+ * The ws2811 code sends with cycle-exact timing, so interrupts are off during a send. If drawing a frame takes longer
+ * than the frame period, show() sends right away and adds the frame periods that were missed to frame_clock::overruns.
+ * The frame clock keeps running, so a late frame does not shift the frames after it.
+ */
+template<typename buffer_type, uint16_t frames_per_second = frame_rate<ws2811::led_buffer_traits<buffer_type>::count>::value>
+class frame_scheduler
+{
+public:
+    static const uint16_t led_count = ws2811::led_buffer_traits<buffer_type>::count;
+
+    static_assert( led_count * 30UL < 1000000UL / frames_per_second, "sending the LEDs takes longer than a frame");
+
+    frame_scheduler( buffer_type &leds, uint8_t channel)
+    : m_leds( leds), m_channel( channel)
+    {
+        frame_clock::start<frames_per_second>();
+        resync();
+    }
+
+    ~frame_scheduler()
+    {
+        frame_clock::stop();
+    }
+
+    /**
+     * Wait for the next frame tick, then send the buffer.
+     */
+    void show()
+    {
+        while (static_cast<int8_t>( frame_clock::ticks - m_next) < 0)
+        {
+            // wait
+        }
+        const uint8_t now = frame_clock::ticks;
+        frame_clock::overruns += static_cast<uint8_t>( now - m_next);
+        m_next = now + 1;
+
+        cli();
+        send( m_leds, m_channel);
+        sei();
+    }
+
+    /**
+     * Let the next frame be due at the next tick, without counting the time since the last frame as overrun.
+     *
+     * Effects that stop showing frames for a while, for instance to wait for input, must call this before they
+     * continue, because the tick counter wraps after 256 frames.
+     */
+    void resync()
+    {
+        m_next = frame_clock::ticks + 1;
+    }
+
+private:
+    buffer_type &m_leds;
+    uint8_t     m_channel;
+    uint8_t     m_next; // tick at which the next frame is due
+};
+
+#endif //FRAME_SCHEDULER_HPP_
@@ -0,0 +1,18 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Host stand-in for avr/pgmspace.h: program memory is ordinary memory.
+#if !defined( HOST_PGMSPACE_H_)
+#define HOST_PGMSPACE_H_
+#include <stdint.h>
+
+#define PROGMEM
+#define pgm_read_byte( address) (*reinterpret_cast<const uint8_t *>( address))
+#define pgm_read_word( address) (*reinterpret_cast<const uint16_t *>( address))
+
+#endif //HOST_PGMSPACE_H_
@@ -0,0 +1,279 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * Host benchmark of ball::draw() of the AVR demo: the indexed, division-free version against the original version
+ * that tests every LED and divides twice per LED in the bounding box.
+ *
+ * Host cycles do not translate directly to AVR cycles, but the ratio between the two versions and the number of
+ * LEDs that are visited per draw do. On the AVR, a 32/16 bit division costs about 200 cycles and a 32 bit
+ * multiplication about 50, and a visited LED costs three program memory reads.
+ *
+ * Strings of more than 255 LEDs use 8.8 fixed point coordinates, for which draw() computes the 8 bits of the scaled
+ * distance with a short shift-and-subtract loop. That loop is slower than the hardware division of the build
+ * machine, but far cheaper than the software division of the AVR. On the build machine, the 120x36 ball on 600 and
+ * 1000 LEDs therefore draws at about 0.7-0.8 times the speed of the original; with a division in its place it draws
+ * at about the same speed, and the 30x30 ball is about twice as fast either way.
+ *
+ * When the bounding box of the ball spans more than half of the LEDs, draw() skips the index and scans the LEDs in
+ * order, so a large ball does not pay for the index.
+ *
+ * Both versions must light exactly the same LEDs with the same shades; the benchmark fails if they differ.
+ */
+
+#include <stdint.h>
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+#if defined( __x86_64__) || defined( __i386__)
+#include <x86intrin.h>
+#endif
+
+#include <ws2811/ws2811.h>
+#include "position.hpp"
+#include "ball.hpp"
+
+namespace
+{
+    using ws2811::rgb;
+
+    /**
+     * The original ball::draw(), as reference, for 8-bit or 8.8 fixed point coordinates.
+     */
+    template<typename buffer_type, uint8_t shade_count, typename coordinate_type>
+    class linear_ball
+    {
+    public:
+        typedef Position<coordinate_type> position_type;
+        typedef Size<coordinate_type> size_type;
+
+        linear_ball( position_type position, size_type size)
+        : m_position( position), m_size(size)
+        {
+        }
+
+        void draw( buffer_type &leds, const position_type *pos, uint16_t count, const rgb (&shades)[shade_count])
+        {
+            for (uint16_t led = 0; led < count; ++led)
+            {
+                if ( absolute_difference( pos[led].x, m_position.x) < m_size.width
+                     and absolute_difference( pos[led].y, m_position.y) < m_size.height)
+                {
+                    uint16_t dist = square_distance( pos[led]);
+                    if (dist < 256)
+                    {
+                        uint8_t index = (dist * shade_count) >> 8;
+                        leds[led] = shades[index];
+                    }
+                }
+            }
+        }
+
+    private:
+        position_type   m_position;
+        size_type       m_size;
+
+        static uint32_t absolute_difference( coordinate_type left, coordinate_type right)
+        {
+            if (left > right) return left - right;
+            else return right - left;
+        }
+
+        uint16_t square_distance( const position_type &pos)
+        {
+            const uint32_t width = (absolute_difference( pos.x, m_position.x) << 8) / m_size.width;
+            const uint32_t height = (absolute_difference( pos.y, m_position.y) << 8) / m_size.height;
+            const Size16 distance = {
+                    static_cast<uint16_t>( std::min<uint32_t>( width, 256)),
+                    static_cast<uint16_t>( std::min<uint32_t>( height, 256))
+            };
+
+            if (distance.width < 256 && distance.height < 256)
+            {
+                return ((distance.width * distance.width) >> 8) + ((distance.height * distance.height) >> 8);
+            }
+            else
+            {
+                return 256;
+            }
+        }
+    };
+
+    /// The tables that LedMapping --header generates, for random positions.
+    template<typename index_type, typename coordinate_type>
+    struct tables
+    {
+        typedef Position<coordinate_type> position_type;
+
+        std::vector<position_type> positions;
+        std::vector<index_type> x_order;
+        std::vector<index_type> x_cells;
+        led_index<index_type, coordinate_type> index;
+
+        tables( uint16_t count, std::mt19937 &random)
+        {
+            std::uniform_int_distribution<int> coordinate( 0, sizeof( coordinate_type) == 1 ? 255 : 255 * 256);
+            for (uint16_t led = 0; led < count; ++led)
+            {
+                const position_type position = {
+                        static_cast<coordinate_type>( coordinate( random)),
+                        static_cast<coordinate_type>( coordinate( random))};
+                positions.push_back( position);
+                x_order.push_back( static_cast<index_type>( led));
+            }
+            std::stable_sort( x_order.begin(), x_order.end(),
+                    [this]( index_type left, index_type right) { return positions[left].x < positions[right].x;});
+
+            uint16_t entry = 0;
+            for (uint16_t cell = 0; cell <= x_cell_count; ++cell)
+            {
+                while (entry < count && x_cell( positions[x_order[entry]].x) < cell) ++entry;
+                x_cells.push_back( static_cast<index_type>( entry));
+            }
+
+            index.positions = positions.data();
+            index.x_order = x_order.data();
+            index.x_cells = x_cells.data();
+            index.count = count;
+        }
+    };
+
+    uint64_t now()
+    {
+#if defined( __x86_64__) || defined( __i386__)
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+    /// Number of LEDs that the indexed draw() looks at.
+    template<typename index_type, typename coordinate_type>
+    uint16_t visited( const tables<index_type, coordinate_type> &t, Position<coordinate_type> position, Size<coordinate_type> size)
+    {
+        const coordinate_type max = static_cast<coordinate_type>( -1);
+        const coordinate_type left = position.x >= size.width ? position.x - size.width + 1 : 0;
+        const coordinate_type right = max - position.x >= size.width ? position.x + size.width - 1 : max;
+        uint16_t count = 0;
+        for (uint16_t entry = t.x_cells[x_cell( left)];
+             entry < t.index.count && t.positions[t.x_order[entry]].x <= right;
+             ++entry)
+        {
+            ++count;
+        }
+        return count;
+    }
+
+    /// Move a ball around like the bouncing_ball() effect does.
+    template<typename coordinate_type>
+    void animate( Position<coordinate_type> &position, Size<coordinate_type> size, Position<coordinate_type> &velocity)
+    {
+        const coordinate_type max = static_cast<coordinate_type>( -1);
+        position.x += velocity.x;
+        position.y += velocity.y;
+        if (position.y < size.height / 2 || position.y > max - size.height / 2) velocity.y = -velocity.y;
+        if (position.x < size.width / 2 || position.x > max - size.width / 2) velocity.x = -velocity.x;
+    }
+
+
+    /// Compare both versions of draw() on a string of 'count' LEDs at random positions, with the coordinates that the
+    /// demo uses for that many LEDs: 8 bits up to 255 LEDs, 8.8 fixed point otherwise.
+    /// Returns false if they did not draw the same frames.
+    template<uint16_t count>
+    bool compare( std::mt19937 &random)
+    {
+        typedef typename select_type< (count > 255), uint16_t, uint8_t>::type coordinate_type;
+        typedef Position<coordinate_type> position_type;
+        typedef Size<coordinate_type> size_type;
+        typedef rgb buffer_type[count];
+        typedef ball<buffer_type, 4, coordinate_type> indexed_ball;
+        const int frames = 20000;
+        const uint16_t scale = sizeof( coordinate_type) == 1 ? 1 : 256;
+        const rgb shades[4] = { rgb( 255, 255, 255), rgb( 128, 128, 128), rgb( 64, 64, 64), rgb( 32, 32, 32)};
+
+        const tables<typename indexed_ball::index_type, coordinate_type> t{ count, random};
+        const size_type sizes[] = {
+                { static_cast<coordinate_type>( 120 * scale), static_cast<coordinate_type>( 36 * scale)},
+                { static_cast<coordinate_type>( 30 * scale), static_cast<coordinate_type>( 30 * scale)}};
+        bool identical = true;
+        for (const size_type &size : sizes)
+        {
+            static buffer_type linear_leds;
+            static buffer_type indexed_leds;
+
+            // with fixed point coordinates, the ball also moves by fractions of the 0..255 grid.
+            position_type position = { static_cast<coordinate_type>( 128 * scale), static_cast<coordinate_type>( 128 * scale)};
+            position_type velocity = {
+                    static_cast<coordinate_type>( 3 * scale + (scale > 1 ? 77 : 0)),
+                    static_cast<coordinate_type>( 2 * scale + (scale > 1 ? 35 : 0))};
+            uint64_t linear_cycles = 0;
+            uint64_t indexed_cycles = 0;
+            uint64_t visits = 0;
+            uint64_t differences = 0;
+            for (int frame = 0; frame < frames; ++frame)
+            {
+                ws2811::clear( linear_leds);
+                ws2811::clear( indexed_leds);
+
+                uint64_t start = now();
+                linear_ball<buffer_type, 4, coordinate_type>{ position, size}.draw( linear_leds, t.positions.data(), count, shades);
+                linear_cycles += now() - start;
+
+                start = now();
+                indexed_ball{ position, size}.draw( indexed_leds, t.index, shades);
+                indexed_cycles += now() - start;
+
+                visits += visited( t, position, size);
+                for (uint16_t led = 0; led < count; ++led)
+                {
+                    if (!(linear_leds[led] == indexed_leds[led])) ++differences;
+                }
+
+                animate( position, size, velocity);
+            }
+
+            std::cout << std::setw( 6) << count << std::setw( 7) << sizeof( typename indexed_ball::index_type)
+                      << std::setw( 7) << sizeof( coordinate_type)
+                      << std::setw( 6) << int( size.width / scale) << 'x' << std::setw( 3) << int( size.height / scale)
+                      << std::fixed << std::setprecision( 1)
+                      << std::setw( 14) << double( linear_cycles) / frames
+                      << std::setw( 14) << double( indexed_cycles) / frames
+                      << std::setw( 9) << double( linear_cycles) / indexed_cycles
+                      << std::setw( 10) << double( visits) / frames
+                      << std::setw( 10) << double( differences) / frames << '\n';
+            if (differences) identical = false;
+        }
+        return identical;
+    }
+}
+
+int main()
+{
+    std::mt19937 random{ 42};
+
+    std::cout << std::setw( 6) << "leds" << std::setw( 7) << "index" << std::setw( 7) << "coord" << std::setw( 10) << "ball"
+              << std::setw( 14) << "linear (cyc)" << std::setw( 14) << "indexed (cyc)" << std::setw( 9) << "speedup"
+              << std::setw( 10) << "visited" << std::setw( 10) << "differ" << '\n';
+
+    bool identical = compare<50>( random);
+    identical = compare<150>( random) && identical;
+    identical = compare<255>( random) && identical;
+    identical = compare<600>( random) && identical;
+    identical = compare<1000>( random) && identical;
+
+    if (!identical)
+    {
+        std::cerr << "The indexed draw() differs from the original.\n";
+        return 1;
+    }
+    return 0;
+}
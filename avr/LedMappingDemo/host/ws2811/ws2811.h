@@ -0,0 +1,52 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+// Host stand-in for the parts of the ws2811 library that the drawing code uses: the rgb type and the buffer traits.
+#if !defined( HOST_WS2811_H_)
+#define HOST_WS2811_H_
+#include <stdint.h>
+
+namespace ws2811
+{
+    struct rgb
+    {
+        rgb( uint8_t red = 0, uint8_t green = 0, uint8_t blue = 0)
+        : red( red), green( green), blue( blue)
+        {
+        }
+
+        bool operator==( const rgb &other) const
+        {
+            return red == other.red && green == other.green && blue == other.blue;
+        }
+
+        uint8_t red;
+        uint8_t green;
+        uint8_t blue;
+    };
+
+    template<typename buffer_type>
+    struct led_buffer_traits;
+
+    template<uint16_t size>
+    struct led_buffer_traits<rgb[size]>
+    {
+        static const uint16_t count = size;
+    };
+
+    template<typename buffer_type>
+    void clear( buffer_type &leds)
+    {
+        for (uint16_t count = 0; count < led_buffer_traits<buffer_type>::count; ++count)
+        {
+            leds[count] = rgb();
+        }
+    }
+}
+
+#endif //HOST_WS2811_H_
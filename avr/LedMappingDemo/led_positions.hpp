@@ -0,0 +1,100 @@
+//
+// LED positions of the original demo setup, in the format of LedMapping --header.
+// The centre points of the two distance tables were not recorded. Regenerate this file for any other setup:
+//     LedMapping --batch --header=led_positions.hpp --centres="128,128;60,100" <video>
+//
+#if !defined( LED_POSITIONS_HPP_)
+#define LED_POSITIONS_HPP_
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "position.hpp"
+
+namespace led_positions {
+
+const uint16_t led_count = 50;
+
+const Position8 PROGMEM position8[] = {
+        { 2, 102},
+        { 55, 95},
+        { 73, 80},
+        { 121, 73},
+        { 94, 56},
+        { 40, 56},
+        { 0, 45},
+        { 41, 34},
+        { 19, 17},
+        { 50, 3},
+        { 109, 2},
+        { 171, 0},
+        { 205, 14},
+        { 174, 30},
+        { 223, 39},
+        { 239, 56},
+        { 212, 69},
+        { 178, 82},
+        { 211, 93},
+        { 186, 107},
+        { 239, 114},
+        { 246, 132},
+        { 197, 144},
+        { 145, 137},
+        { 150, 119},
+        { 114, 107},
+        { 63, 118},
+        { 36, 134},
+        { 95, 141},
+        { 103, 158},
+        { 41, 156},
+        { 18, 172},
+        { 75, 175},
+        { 129, 182},
+        { 171, 168},
+        { 224, 159},
+        { 246, 176},
+        { 255, 196},
+        { 212, 209},
+        { 151, 204},
+        { 89, 202},
+        { 32, 211},
+        { 86, 222},
+        { 149, 226},
+        { 214, 227},
+        { 230, 240},
+        { 171, 247},
+        { 110, 255},
+        { 77, 241},
+        { 18, 241},
+};
+
+// LEDs sorted on x, and the first entry in x_order of every cell of 16 x-values.
+const uint8_t PROGMEM x_order[] = {
+        6, 0, 31, 49, 8, 41, 27, 5, 7, 30, 9, 1, 26, 2, 32, 48,
+        42, 40, 4, 28, 29, 10, 47, 25, 3, 33, 23, 43, 24, 39, 11, 34,
+        46, 13, 17, 19, 22, 12, 18, 16, 38, 44, 14, 35, 45, 15, 20, 21,
+        36, 37,
+};
+const uint8_t PROGMEM x_cells[] = {
+        0, 2, 5, 10, 13, 16, 20, 23, 25, 26, 30, 34, 36, 38, 43, 47, 50,
+};
+
+typedef led_index<uint8_t> index_table;
+const index_table index = { position8, x_order, x_cells, led_count};
+
+// distance to centre 0, the farthest LED is at 255.
+const uint8_t PROGMEM distances0[] = {
+        88, 76, 99, 107, 141, 149, 179, 192, 228, 251, 248, 255, 228, 196, 185, 155,
+        124, 94, 83, 52, 70, 69, 52, 22, 20, 39, 41, 55, 33, 63, 76, 110,
+        99, 109, 86, 85, 120, 156, 171, 155, 152, 176, 190, 197, 206, 233, 240, 254,
+        230, 236,
+};
+
+// distance to centre 1, the farthest LED is at 255.
+const uint8_t PROGMEM distances1[] = {
+        46, 66, 96, 120, 141, 133, 152, 175, 205, 233, 239, 255, 237, 205, 205, 185,
+        158, 128, 131, 108, 133, 134, 112, 81, 83, 72, 38, 24, 58, 81, 58, 85,
+        97, 124, 121, 136, 162, 189, 192, 166, 148, 157, 182, 201, 220, 245, 242, 245,
+        217, 213,
+};
+
+}
+#endif //LED_POSITIONS_HPP_
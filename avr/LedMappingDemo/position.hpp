@@ -0,0 +1,103 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#if !defined( POSITION_HPP_)
+#define POSITION_HPP_
+#include <stdint.h>
+#include <avr/pgmspace.h>
+#include "../led_index_type.hpp"
+
+template<typename CoordinateType>
+struct Position {
+    CoordinateType x;
+    CoordinateType y;
+};
+
+template<typename CoordinateType>
+struct Size
+{
+    CoordinateType width;
+    CoordinateType height;
+};
+
+typedef Position<uint8_t>   Position8;
+typedef Position<uint16_t>  Position16; // position in 8.8 fixed point
+typedef Size<uint8_t>       Size8;
+typedef Size<uint16_t>      Size16;
+
+/**
+ * Index of the LED positions on x-coordinate, for effects that only need the LEDs in a part of the area.
+ *
+ * x_order lists the LEDs sorted on x-coordinate. The x-range 0..255 is divided in cells of 2^x_cell_shift wide
+ * and x_cells[c] is the first entry in x_order of an LED with (x >> x_cell_shift) >= c, so x_cells has
+ * x_cell_count + 1 entries and the last one is the LED count. All three tables are in program memory and are
+ * generated by LedMapping --header, with uint8_t entries for up to 255 LEDs and uint16_t entries otherwise.
+ *
+ * The positions are either Position8 or the 8.8 fixed point Position16, whose integer part selects the cell.
+ */
+const uint8_t x_cell_shift = 4;
+const uint8_t x_cell_count = 256 >> x_cell_shift;
+
+template< typename index_type, typename coordinate_type = uint8_t>
+struct led_index
+{
+    typedef coordinate_type coordinate;
+
+    const Position<coordinate_type> *positions;
+    const index_type    *x_order;
+    const index_type    *x_cells;
+    uint16_t            count;
+};
+
+/**
+ * The cell of x_cells that contains the given x-coordinate.
+ */
+inline uint8_t x_cell( uint8_t x)
+{
+    return x >> x_cell_shift;
+}
+
+inline uint8_t x_cell( uint16_t x)
+{
+    return x >> (x_cell_shift + 8);
+}
+
+/**
+ * Read an LED index from a table in program memory.
+ */
+inline uint8_t read_index( const uint8_t *table, uint16_t entry)
+{
+    return pgm_read_byte( &table[entry]);
+}
+
+inline uint16_t read_index( const uint16_t *table, uint16_t entry)
+{
+    return pgm_read_word( &table[entry]);
+}
+
+/**
+ * Read a position from a table in program memory.
+ */
+inline Position8 read_position( const Position8 *table, uint16_t index)
+{
+    const Position8 position = {
+            pgm_read_byte( &table[index].x),
+            pgm_read_byte( &table[index].y)
+    };
+    return position;
+}
+
+inline Position16 read_position( const Position16 *table, uint16_t index)
+{
+    const Position16 position = {
+            pgm_read_word( &table[index].x),
+            pgm_read_word( &table[index].y)
+    };
+    return position;
+}
+
+#endif //POSITION_HPP_
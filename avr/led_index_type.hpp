@@ -0,0 +1,34 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+#if !defined( LED_INDEX_TYPE_HPP_)
+#define LED_INDEX_TYPE_HPP_
+#include <stdint.h>
+
+template< bool condition, typename if_true, typename if_false>
+struct select_type
+{
+    typedef if_true type;
+};
+
+template< typename if_true, typename if_false>
+struct select_type<false, if_true, if_false>
+{
+    typedef if_false type;
+};
+
+/**
+ * The smallest unsigned type that can hold the index of any of 'count' LEDs, and the count itself.
+ * Strings of up to 255 LEDs keep using 8-bit indices, longer strings use 16 bits.
+ */
+template< uint16_t count>
+struct led_index_type
+{
+    typedef typename select_type< (count > 255), uint16_t, uint8_t>::type type;
+};
+
+#endif //LED_INDEX_TYPE_HPP_
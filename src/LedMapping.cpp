@@ -16,15 +16,29 @@
 #include <opencv2/opencv.hpp>
 #include <random>
 
+#include "led_detector.hpp"
+#include "binary_pattern_decoder.hpp"
+#include "color_sequence_decoder.hpp"
+#include "firmware_header.hpp"
+
+#include <algorithm>
+#include <atomic>
 #include <cmath>
+#include <chrono>
+#include <exception>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
 #include <stdexcept>
 #include <string>
+#include <thread>
+#include <vector>
 
 
 using namespace cv;
 namespace
 {
-    const std::string windowName = "LED Finder";
     const int fixedThreshold = 250;
 }
 
@@ -124,226 +138,325 @@ void TweakParameters( )
 }
 ***************************************************/
 
-void ShowTweaked( int, void*);
+/// Print the LED positions scaled to 0..255, or with 16-bit resolution (8.8 fixed point, 0..65535) which is the
+/// better choice for strings of more than 255 LEDs.
+void PrintResult( std::ostream &output, const std::vector<KeyPoint> &results, bool sixteenBits)
+{
+    output << "Found " << results.size() << " LEDs\n";
+    const float scale = sixteenBits ? 256.0f : 1.0f;
+    for ( const auto &position: Detection::NormalisedPositions( results))
+    {
+        output << "{ " << static_cast<int>( position.x * scale) << ", " << static_cast<int>( position.y * scale) << "},\n";
+    }
+}
 
-class LedDetector
+void PrintSummary( std::ostream &output, const LedDetector::ScanSummary &summary)
 {
-public:
-    LedDetector( const std::string &fileName)
-    :m_fileName{ fileName}
+    output << "// scanned " << summary.frames << " frames in " << summary.seconds << "s ("
+           << summary.FramesPerSecond() << " fps, "
+           << summary.allocations << " frame buffer allocations, "
+           << summary.cacheAllocations << " cached images, "
+           << summary.grabbedOnly << " frames not decoded)\n";
+}
+
+/// Open a video file for one of the sequence decoders.
+void OpenVideoFile( const std::string &fileName, VideoCapture &video)
+{
+    video.open( fileName);
+    if (!video.isOpened())
     {
-        Setup();
-        ScanSequence();
+        throw std::runtime_error(std::string{"Can't open file "} + fileName);
     }
+}
 
-    void ScanSequence( )
+/// Warn about LED indices that are missing from, or duplicated in results that are sorted on index.
+void ReportMissing( const std::vector<KeyPoint> &results)
+{
+    int expected = 0;
+    for (const auto &led : results)
     {
-        VideoCapture video;
-        video.open( m_fileName);
-        if (!video.isOpened())
+        if (led.class_id < expected)
         {
-            throw std::runtime_error(std::string{"Can't open file "} + m_fileName);
+            std::cerr << "LED index " << led.class_id << " was found more than once\n";
         }
-
-        video >> m_previous;
-        ShowDetected();
-        while( video.read( m_current))
+        for (; expected < led.class_id; ++expected)
         {
-            if (Update())
-            {
-                // skip next frame if LED detected
-                video.read( m_previous);
-            }
-            else
-            {
-                m_previous = std::move( m_current);
-            }
+            std::cerr << "LED index " << expected << " was not found\n";
         }
-
-        std::cout << "Detected " << m_foundLeds.size() << "LEDs.\n";
-        ShowDetected();
-    }
-
-    void Setup()
-    {
-        namedWindow(windowName, WINDOW_AUTOSIZE);
-
-        createTrackbar( "min distance",
-                        windowName, &settings.minDist,
-                        500, ShowTweaked, this);
-
-        createTrackbar( "min Area",
-                        windowName, &settings.minArea,
-                        2000, ShowTweaked, this );
-        createTrackbar( "max Area",
-                        windowName, &settings.maxArea,
-                        2000, ShowTweaked, this);
-
-        createTrackbar( "lower Treshold",
-                        windowName, &settings.lowerThreshold,
-                        300, ShowTweaked, this);
-        createTrackbar( "upper Threshold",
-                        windowName, &settings.upperThreshold,
-                        300, ShowTweaked, this);
-
-        createTrackbar( "lower Hue",
-                        windowName, &settings.lowerHue,
-                        300, ShowTweaked, this);
-        createTrackbar( "upper Hue",
-                        windowName, &settings.upperHue,
-                        300, ShowTweaked, this);
-        createTrackbar( "blur",
-                        windowName, &settings.blurValue,
-                        10, ShowTweaked, this);
-
-    }
-
-    void Feed( const Mat &current, const Mat &previous)
-    {
-        m_current = current;
-        m_previous = previous;
-        Update();
-        auto key = waitKey(20);
-        std::cout << "received key: " << key << std::endl;
-    }
-
-    std::vector<KeyPoint> GetResults() const
-    {
-        return m_foundLeds;
+        expected = led.class_id + 1;
     }
+}
 
-    bool Update( )
-    {
+/// Decode a video of the binary_pattern() registration sequence of the AVR code, for a string of ledCount LEDs
+/// (0 if not known). The results are sorted on LED index and have that index in their class_id.
+std::vector<KeyPoint> DecodeBinaryPattern(
+        const std::string &fileName,
+        const LedDetector::Settings &settings,
+        std::size_t ledCount,
+        LedDetector::ScanSummary &summary)
+{
+    VideoCapture video;
+    OpenVideoFile( fileName, video);
 
-        Mat bgr[3];
-        split( m_current - m_previous, bgr);
+    const auto start = std::chrono::steady_clock::now();
+    Detection::BinaryPatternDecoder decoder{
+        LedDetector::ChannelParams( settings), static_cast<std::size_t>( settings.minPatternLeds), ledCount};
+    const auto results = decoder.Decode( video);
 
-        Mat analysis;
-        GaussianBlur( bgr[2], analysis, Size{ 1 + 2 * settings.blurValue, 1 + 2 * settings.blurValue}, 0);
+    summary.frames = static_cast<unsigned int>( decoder.GetFrameCount());
+    summary.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
 
-        inRange( analysis,
-                Scalar( settings.lowerThreshold),
-                Scalar( settings.upperThreshold),
-                analysis);
+    std::cerr << "Found " << decoder.GetPatternCount() << " pattern frames\n";
+    ReportMissing( results);
 
-        SimpleBlobDetector::Params params;
-        params.minDistBetweenBlobs = settings.minDist;
-        params.filterByInertia = false;
+    return results;
+}
 
-        params.filterByConvexity = true;
-        params.minConvexity = 0.5;
-        params.maxConvexity = 1.1;
+/// Decode a video of the color_registration() sequence of the AVR code.
+/// The results are sorted on LED index and have that index in their class_id.
+std::vector<KeyPoint> DecodeColorSequence(
+        const std::string &fileName,
+        const LedDetector::Settings &settings,
+        LedDetector::ScanSummary &summary)
+{
+    VideoCapture video;
+    OpenVideoFile( fileName, video);
 
-        params.filterByColor = true;
-        params.blobColor = 255;
+    const auto start = std::chrono::steady_clock::now();
+    Detection::ColorSequenceDecoder decoder{ LedDetector::ChannelParams( settings), static_cast<std::size_t>( settings.resetCount)};
+    const auto results = decoder.Decode( video);
 
-        params.filterByArea = true;
-        params.minArea = settings.minArea;
-        params.maxArea = settings.maxArea;
+    summary.frames = static_cast<unsigned int>( decoder.GetFrameCount());
+    summary.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
 
-        params.minThreshold = 150;
-        params.maxThreshold = 254;
+    ReportMissing( results);
 
-        params.filterByCircularity = true;
-        params.minCircularity = .5;
-        params.maxCircularity = 1.1;
+    return results;
+}
 
-        Ptr<SimpleBlobDetector> detector = SimpleBlobDetector::create(params);
-        std::vector<KeyPoint> features;
-        detector->detect(analysis, features);
+/// Create a sink that streams the LEDs to a file, or to stdout if the file name is "-".
+std::unique_ptr<Detection::ResultSink> OpenStream( const std::string &fileName, const std::string &format, std::ofstream &file)
+{
+    if (format != "json" && format != "binary")
+    {
+        throw std::runtime_error( "Unknown stream format " + format);
+    }
 
-        if (features.size() == 1)
-        {
-            m_foundLeds.push_back( features[0]);
-        }
-        else if (features.size() > 8)
+    if (fileName != "-")
+    {
+        file.open( fileName, format == "binary" ? std::ios::binary : std::ios::out);
+        if (!file)
         {
-            m_foundLeds.clear();
+            throw std::runtime_error( "Can't open stream file " + fileName);
         }
-
-        return features.size() == 1;
     }
+    std::ostream &output = file.is_open() ? file : std::cout;
 
-    void ShowDetected()
+    if (format == "binary")
     {
-        Mat allFeatures;
-        drawKeypoints( m_previous, m_foundLeds, allFeatures, Scalar::all(-1),
-                DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
-        imshow( windowName, allFeatures);
+        return std::unique_ptr<Detection::ResultSink>{ new Detection::BinarySink{ output}};
     }
+    return std::unique_ptr<Detection::ResultSink>{ new Detection::JsonLinesSink{ output}};
+}
 
-private:
-    typedef std::vector<KeyPoint> KeyPoints;
-
-    struct Settings {
-        int minDist = 3;
-        int minArea = 70;
-        int maxArea = 3000;
-        int lowerThreshold = 65;
-        int upperThreshold = 255;
-        int lowerHue = 99;
-        int upperHue = 105;
-        int blurValue = 9;
-    };
-
-    Settings settings;
-    std::vector<KeyPoint> m_foundLeds;
-    Mat m_current;
-    Mat m_previous;
-    std::string m_fileName;
-};
-
-void ShowTweaked( int, void *detector )
+/// Write the stage timings and counters of a scan to a file, as JSON if the name ends in .json and as CSV otherwise.
+void WriteProfile( const std::string &fileName, const Detection::Profiler &profile)
 {
-    reinterpret_cast<LedDetector*>( detector)->ScanSequence();
+    std::ofstream file{ fileName};
+    if (!file)
+    {
+        throw std::runtime_error( "Can't open profile file " + fileName);
+    }
+
+    const std::string json = ".json";
+    if (fileName.size() >= json.size() && fileName.compare( fileName.size() - json.size(), json.size(), json) == 0)
+    {
+        profile.WriteJson( file);
+    }
+    else
+    {
+        profile.WriteCsv( file);
+    }
 }
 
-void PrintResult( const std::vector<KeyPoint> &results)
+/// Overwrite settings with all values that are present in a settings file (yml, xml or json).
+void ReadSettings( const std::string &fileName, LedDetector::Settings &settings)
 {
-    std::cout << "Found " << results.size() << " LEDs\n";
-    Point2f lowerLeft = results[0].pt;
-    Point2f upperRight = results[0].pt;
-    for ( const auto &point: results)
+    FileStorage file{ fileName, FileStorage::READ};
+    if (!file.isOpened())
     {
-        const auto pt = point.pt;
-        if (pt.x < lowerLeft.x) lowerLeft.x = pt.x;
-        if (pt.y < lowerLeft.y) lowerLeft.y = pt.y;
-        if (pt.x > upperRight.x) upperRight.x = pt.x;
-        if (pt.y > upperRight.y) upperRight.y = pt.y;
+        throw std::runtime_error(std::string{"Can't open settings file "} + fileName);
     }
 
-    auto xRange = upperRight.x - lowerLeft.x;
-    auto yRange = upperRight.y - lowerLeft.y;
+    for (const auto &field : LedDetector::Settings::Fields())
+    {
+        const FileNode node = file[field.first];
+        if (!node.empty())
+        {
+            node >> (settings.*field.second);
+        }
+    }
+}
 
-    for ( const auto &point: results)
+/// Overwrite settings with all values that were given on the command line.
+void ReadSettings( const CommandLineParser &parser, LedDetector::Settings &settings)
+{
+    for (const auto &field : LedDetector::Settings::Fields())
     {
-        auto x = static_cast<int>( 255 * ((point.pt.x - lowerLeft.x) / xRange));
-        auto y = static_cast<int>( 255 * ((point.pt.y - lowerLeft.y)/ yRange));
+        if (parser.has( field.first))
+        {
+            settings.*field.second = parser.get<int>( field.first);
+        }
+    }
+}
 
-        std::cout << "{ " << x << ", " << y << "},\n";
+std::string CommandLineKeys()
+{
+    std::string keys =
+            "{help h usage ? |  | print this message}"
+            "{@video         |  | video file to scan}"
+            "{batch b        |  | run without any GUI and write the results to stdout or to the output file}"
+            "{settings s     |  | read detector settings from this file (yml, xml or json)}"
+            "{output o       |  | write results to this file instead of to stdout}"
+            "{sequence q     |simple| registration sequence in the video: simple (one LED at a time), color (three at a time) or binary}"
+            "{leds n         |0 | number of LEDs in the string, the binary sequence has ceil(log2(leds)) pattern frames (0: unknown)}"
+            "{threads t      |1 | number of threads to use while decoding the video, 0 means one per core}"
+            "{cache c        |  | size in MB of the frame difference cache (default: 0 in batch mode, 1024 otherwise)}"
+            "{stream         |  | write every LED to this file (- for stdout, requires --output) as soon as it is found}"
+            "{streamFormat   |json| format of the stream: json (one object per line) or binary}"
+            "{header         |  | write an AVR header with the LED positions and distance tables to this file}"
+            "{centres        |128,128| centre points of the distance tables in the header, as x,y;x,y;... in 0..255}"
+            "{position16     |  | also write 8.8 fixed point positions to the header (automatic for more than 255 LEDs)}"
+            "{resolution     |0 | bits per printed coordinate: 8 (0..255), 16 (8.8 fixed point) or 0: 16 for more than 255 LEDs}"
+            "{profile p      |  | write stage timings to this file (.json or .csv), needs a build with LED_PROFILING}";
+
+    for (const auto &field : LedDetector::Settings::Fields())
+    {
+        keys += std::string{"{"} + field.first + "||detector setting}";
     }
+
+    return keys;
 }
 
 int main(int argc, char** argv)
 {
+    CommandLineParser parser{ argc, argv, CommandLineKeys()};
+    parser.about( "Find the positions of LEDs in a video of a registration sequence.");
 
-    if (argc != 2)
+    const auto video = parser.get<std::string>( "@video");
+    if (parser.has( "help") || video.empty() || !parser.check())
     {
-        printf("usage: LedMapping <video>\n");
+        parser.printErrors();
+        parser.printMessage();
         return -1;
     }
 
     try
     {
-        LedDetector detector{argv[1]};
-        waitKey(0);
+        LedDetector::Settings settings;
+        if (parser.has( "settings"))
+        {
+            ReadSettings( parser.get<std::string>( "settings"), settings);
+        }
+        ReadSettings( parser, settings);
 
-        PrintResult( detector.GetResults());
+        // the stream records and the final results can't share stdout.
+        if (parser.has( "stream") && parser.get<std::string>( "stream") == "-" && !parser.has( "output"))
+        {
+            throw std::runtime_error( "--stream=- writes to stdout, use --output=<file> for the final results");
+        }
+
+        const bool batch = parser.has( "batch");
+        const auto sequence = parser.get<std::string>( "sequence");
+        std::vector<KeyPoint> results;
+        LedDetector::ScanSummary summary;
+        if (sequence == "binary")
+        {
+            results = DecodeBinaryPattern( video, settings, parser.get<unsigned int>( "leds"), summary);
+        }
+        else if (sequence == "color")
+        {
+            results = DecodeColorSequence( video, settings, summary);
+        }
+        else if (sequence == "simple")
+        {
+            LedDetector detector{ video, settings, !batch};
+            const std::size_t cacheMegabytes = parser.has( "cache") ? parser.get<unsigned int>( "cache") : batch ? 0 : 1024;
+            detector.SetCacheLimit( cacheMegabytes * 1024 * 1024);
+            const unsigned int threads = parser.get<unsigned int>( "threads");
+            detector.SetThreads( threads ? threads : std::thread::hardware_concurrency());
+
+            std::ofstream streamFile;
+            std::unique_ptr<Detection::ResultSink> sink;
+            if (parser.has( "stream"))
+            {
+                sink = OpenStream( parser.get<std::string>( "stream"), parser.get<std::string>( "streamFormat"), streamFile);
+                detector.SetSink( sink.get());
+            }
+            detector.ScanSequence();
+
+            if (!batch)
+            {
+                waitKey(0);
+            }
+
+            results = detector.GetResults();
+            summary = detector.GetSummary();
+
+            if (Detection::Profiler::IsEnabled())
+            {
+                detector.GetProfile().Print( std::cerr);
+                if (parser.has( "profile"))
+                {
+                    WriteProfile( parser.get<std::string>( "profile"), detector.GetProfile());
+                }
+            }
+            else if (parser.has( "profile"))
+            {
+                std::cerr << "This build does not collect stage timings, configure with -DLED_PROFILING=ON\n";
+            }
+        }
+        else
+        {
+            throw std::runtime_error( "Unknown sequence type " + sequence);
+        }
+
+        std::ofstream outputFile;
+        if (parser.has( "output"))
+        {
+            outputFile.open( parser.get<std::string>( "output"));
+            if (!outputFile)
+            {
+                throw std::runtime_error( "Can't open output file " + parser.get<std::string>( "output"));
+            }
+        }
+        std::ostream &output = outputFile.is_open() ? outputFile : std::cout;
+
+        PrintSummary( output, summary);
+        const int resolution = parser.get<int>( "resolution");
+        PrintResult( output, results, resolution == 16 || (resolution == 0 && results.size() > 255));
+
+        if (parser.has( "header"))
+        {
+            const auto headerName = parser.get<std::string>( "header");
+            std::ofstream header{ headerName};
+            if (!header)
+            {
+                throw std::runtime_error( "Can't open header file " + headerName);
+            }
+            const Detection::FirmwareHeader firmware{
+                results, Detection::ParseCentres( parser.get<std::string>( "centres")), parser.has( "position16")};
+            firmware.Write( header, video);
+        }
     }
     catch( cv::Exception& e )
     {
         std::cerr << "OpenCV exception: " << e.what() << std::endl;
     }
+    catch( std::exception& e )
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
     return 0;
 }
-
@@ -0,0 +1,270 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( BINARY_PATTERN_DECODER_HPP_)
+#define BINARY_PATTERN_DECODER_HPP_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <initializer_list>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include "channel_detector.hpp"
+
+namespace Detection
+{
+
+/// Decoder for the binary_pattern() sequence of the AVR registration code.
+///
+/// In that sequence every LED is lit in every pattern frame, either red or blue, with dark frames in between.
+/// In pattern frame k (counting from 0), LED i is blue if bit (n - 1 - k) of i is set, where n is the number of
+/// pattern frames. This means that n frames identify 2^n LEDs.
+///
+/// The decoder finds the frames in which the LEDs switch on, finds the red and blue blobs in them, matches the
+/// blobs of all pattern frames by position and reads the index of every LED from its colours.
+///
+/// A video may show more on-transitions than one pass of the sequence: the AVR code repeats it, and other flashes
+/// may come before it. The pattern frames are therefore grouped in passes. A pass ends after ceil(log2 n) pattern
+/// frames for a string of n LEDs, or at a dark gap that is longer than PassGapMs, and Result() decodes the last
+/// pass that is complete. Without a known LED count, it decodes the longest pass.
+class BinaryPatternDecoder
+{
+public:
+    /// A dark gap this long (in ms) ends a pass of the sequence, the AVR code leaves 100ms between pattern frames.
+    static constexpr double PassGapMs = 300.0;
+
+    /// ledCount is the number of LEDs in the string, 0 if it is not known.
+    BinaryPatternDecoder( const ChannelDetector::Params &params, std::size_t minLeds, std::size_t ledCount)
+    : m_detector( params), m_minLeds( minLeds), m_patternLimit( PatternCount( ledCount))
+    {
+    }
+
+    /// Decode a complete video.
+    /// Returns the LED positions, sorted on LED index, with the index in the class_id of every key point.
+    std::vector<cv::KeyPoint> Decode( cv::VideoCapture &video)
+    {
+        Reset();
+        SetFrameRate( video.get( cv::CAP_PROP_FPS));
+        cv::Mat frame;
+        while (video.read( frame))
+        {
+            Feed( frame);
+        }
+        return Result();
+    }
+
+    void Reset()
+    {
+        m_patterns.clear();
+        m_complete.clear();
+        m_state = WaitingForOn;
+        m_frames = 0;
+        m_darkFrames = 0;
+        m_dark.release();
+    }
+
+    /// Set the frame rate of the video, which determines how many dark frames end a pass.
+    /// Without a frame rate (fps <= 0), only the pattern count ends a pass.
+    void SetFrameRate( double fps)
+    {
+        m_maxDarkFrames = fps > 0 ? static_cast<std::size_t>( std::ceil( PassGapMs * fps / 1000.0)) : 0;
+    }
+
+    /// Process the next frame of the video.
+    void Feed( const cv::Mat &frame)
+    {
+        ++m_frames;
+        if (m_dark.empty())
+        {
+            frame.copyTo( m_dark);
+            return;
+        }
+
+        switch (m_state)
+        {
+        case WaitingForOn:
+            Detect( frame, m_candidate);
+            if (m_candidate.Count() >= m_minLeds)
+            {
+                const bool gap = m_maxDarkFrames && m_darkFrames > m_maxDarkFrames;
+                if (gap || (m_patternLimit && m_patterns.size() == m_patternLimit))
+                {
+                    EndPass();
+                }
+                m_state = Confirming;
+            }
+            else
+            {
+                ++m_darkFrames;
+                // keep the reference as recent as possible
+                frame.copyTo( m_dark);
+            }
+            break;
+
+        case Confirming:
+            // the LEDs may have switched on halfway through the exposure of the previous frame,
+            // so use whichever of the two frames shows most LEDs.
+            Detect( frame, m_next);
+            m_patterns.push_back( m_next.Count() > m_candidate.Count() ? m_next : m_candidate);
+            m_state = WaitingForOff;
+            break;
+
+        case WaitingForOff:
+            Detect( frame, m_next);
+            if (m_next.Count() < m_minLeds / 2)
+            {
+                frame.copyTo( m_dark);
+                m_darkFrames = 0;
+                m_state = WaitingForOn;
+            }
+            break;
+        }
+    }
+
+    /// Match the blobs of all pattern frames of the best pass and decode the LED index of every blob in its first frame.
+    std::vector<cv::KeyPoint> Result() const
+    {
+        std::vector<cv::KeyPoint> leds;
+        const std::vector<Pattern> &patterns = Best();
+        if (patterns.empty()) return leds;
+
+        for (const auto &blobs : { &patterns[0].red, &patterns[0].blue})
+        {
+            for (const auto &first : *blobs)
+            {
+                cv::KeyPoint led = first;
+                int index = 0;
+                cv::Point2f sum( 0, 0);
+                bool complete = true;
+                for (const auto &pattern : patterns)
+                {
+                    // the blob must be closer than one blob diameter to count as the same LED.
+                    const cv::KeyPoint *red = Nearest( pattern.red, first);
+                    const cv::KeyPoint *blue = Nearest( pattern.blue, first);
+                    const cv::KeyPoint *match =
+                            !blue || (red && Distance( *red, first) <= Distance( *blue, first)) ? red : blue;
+                    if (!match)
+                    {
+                        complete = false;
+                        break;
+                    }
+
+                    index = 2 * index + (match == blue ? 1 : 0);
+                    sum += match->pt;
+                }
+
+                if (complete)
+                {
+                    led.pt = sum * (1.0f / patterns.size());
+                    led.class_id = index;
+                    leds.push_back( led);
+                }
+            }
+        }
+
+        std::sort( leds.begin(), leds.end(),
+                []( const cv::KeyPoint &left, const cv::KeyPoint &right) { return left.class_id < right.class_id;});
+        return leds;
+    }
+
+    /// Number of pattern frames in the pass that Result() decodes.
+    std::size_t GetPatternCount() const
+    {
+        return Best().size();
+    }
+
+    /// Number of frames fed to the decoder.
+    std::size_t GetFrameCount() const
+    {
+        return m_frames;
+    }
+
+private:
+    struct Pattern
+    {
+        std::vector<cv::KeyPoint> red;
+        std::vector<cv::KeyPoint> blue;
+
+        std::size_t Count() const
+        {
+            return red.size() + blue.size();
+        }
+    };
+
+    enum State { WaitingForOn, Confirming, WaitingForOff};
+
+    /// Number of pattern frames in one pass for a string of ledCount LEDs, 0 if ledCount is not known.
+    static std::size_t PatternCount( std::size_t ledCount)
+    {
+        std::size_t count = 0;
+        while ((std::size_t( 1) << count) < ledCount) ++count;
+        return ledCount ? std::max<std::size_t>( count, 1) : 0;
+    }
+
+    /// The pass to decode: the current one if it is complete, otherwise the last complete one. Without a pattern
+    /// limit, the longest of the two.
+    const std::vector<Pattern> &Best() const
+    {
+        if (m_complete.empty()) return m_patterns;
+        if (m_patternLimit) return m_patterns.size() == m_patternLimit ? m_patterns : m_complete;
+        return m_patterns.size() > m_complete.size() ? m_patterns : m_complete;
+    }
+
+    /// Keep the current pass if it is better than the last complete one and start a new pass.
+    void EndPass()
+    {
+        if (&Best() == &m_patterns) m_complete.swap( m_patterns);
+        m_patterns.clear();
+    }
+
+    /// Find the red and blue blobs that appear in frame, compared to the last dark frame.
+    void Detect( const cv::Mat &frame, Pattern &pattern)
+    {
+        m_detector.Detect( frame, m_dark, 2, pattern.red);
+        m_detector.Detect( frame, m_dark, 0, pattern.blue);
+    }
+
+    static double Distance( const cv::KeyPoint &left, const cv::KeyPoint &right)
+    {
+        return cv::norm( left.pt - right.pt);
+    }
+
+    static const cv::KeyPoint *Nearest( const std::vector<cv::KeyPoint> &blobs, const cv::KeyPoint &target)
+    {
+        const cv::KeyPoint *nearest = nullptr;
+        double nearestDistance = std::max( target.size, 1.0f);
+        for (const auto &blob : blobs)
+        {
+            const double distance = Distance( blob, target);
+            if (distance < nearestDistance)
+            {
+                nearest = &blob;
+                nearestDistance = distance;
+            }
+        }
+        return nearest;
+    }
+
+    ChannelDetector     m_detector;
+    std::size_t         m_minLeds;     // a frame with fewer blobs than this is not a pattern frame
+    std::size_t         m_patternLimit; // number of pattern frames in a pass, 0 if not known
+    std::size_t         m_maxDarkFrames = 0; // more dark frames than this end a pass, 0: no limit
+    std::vector<Pattern> m_patterns;    // pattern frames of the current pass
+    std::vector<Pattern> m_complete;    // the best pass before the current one
+    State               m_state = WaitingForOn;
+    std::size_t         m_frames = 0;
+    std::size_t         m_darkFrames = 0; // frames since the LEDs switched off
+    Pattern             m_candidate;
+    Pattern             m_next;
+    cv::Mat             m_dark;
+};
+
+}
+#endif //BINARY_PATTERN_DECODER_HPP_
@@ -0,0 +1,163 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * A/B benchmark for the blob detection stage of the LED detector: cv::SimpleBlobDetector against
+ * Detection::BlobFinder, on the kind of binary images that LedDetector::Update() produces.
+ *
+ * Without arguments this runs on synthetic 1920x1080 masks. Any arguments are taken to be image files, which are
+ * thresholded at 128 before use.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "blob_finder.hpp"
+
+using namespace cv;
+namespace
+{
+    struct Sample
+    {
+        std::string name;
+        Mat mask;
+    };
+
+    /// the same parameters that the LED detector uses with its default settings.
+    SimpleBlobDetector::Params DetectorParams()
+    {
+        SimpleBlobDetector::Params params;
+        params.minDistBetweenBlobs = 3;
+        params.filterByInertia = false;
+
+        params.filterByConvexity = true;
+        params.minConvexity = 0.5;
+        params.maxConvexity = 1.1;
+
+        params.filterByColor = true;
+        params.blobColor = 255;
+
+        params.filterByArea = true;
+        params.minArea = 70;
+        params.maxArea = 3000;
+
+        params.minThreshold = 150;
+        params.maxThreshold = 254;
+
+        params.filterByCircularity = true;
+        params.minCircularity = .5;
+        params.maxCircularity = 1.1;
+
+        return params;
+    }
+
+    /// Create a mask with a number of lit, LED-sized discs and some single-pixel noise.
+    Mat SyntheticMask( int blobCount, RNG &rng)
+    {
+        Mat mask = Mat::zeros( 1080, 1920, CV_8UC1);
+        for (int count = 0; count < blobCount; ++count)
+        {
+            const Point center{ rng.uniform( 40, mask.cols - 40), rng.uniform( 40, mask.rows - 40)};
+            circle( mask, center, rng.uniform( 6, 25), Scalar( 255), FILLED);
+        }
+        for (int count = 0; count < 200; ++count)
+        {
+            mask.at<uchar>( rng.uniform( 0, mask.rows), rng.uniform( 0, mask.cols)) = 255;
+        }
+        return mask;
+    }
+
+    /// Run f a number of times and return the average time per call in milliseconds.
+    template<typename Function>
+    double MillisecondsPerCall( Function f, int repetitions)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        for (int count = 0; count < repetitions; ++count)
+        {
+            f();
+        }
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        return elapsed.count() / repetitions;
+    }
+
+    /// Largest distance between a key point in 'a' and the closest key point in 'b'.
+    double MaxDeviation( const std::vector<KeyPoint> &a, const std::vector<KeyPoint> &b)
+    {
+        double result = 0.0;
+        for (const auto &pa : a)
+        {
+            double closest = HUGE_VAL;
+            for (const auto &pb : b)
+            {
+                closest = std::min( closest, static_cast<double>( norm( pa.pt - pb.pt)));
+            }
+            result = std::max( result, closest);
+        }
+        return result;
+    }
+}
+
+int main( int argc, char **argv)
+{
+    const int repetitions = 20;
+
+    std::vector<Sample> samples;
+    if (argc > 1)
+    {
+        for (int arg = 1; arg < argc; ++arg)
+        {
+            Mat image = imread( argv[arg], 0);
+            if (image.empty())
+            {
+                std::cerr << "Can't read image " << argv[arg] << '\n';
+                return -1;
+            }
+            threshold( image, image, 128, 255, THRESH_BINARY);
+            samples.push_back( Sample{ argv[arg], image});
+        }
+    }
+    else
+    {
+        RNG rng{ 42};
+        for (int blobs : { 0, 1, 2, 8, 50})
+        {
+            samples.push_back( Sample{ "synthetic, " + std::to_string( blobs) + " blobs", SyntheticMask( blobs, rng)});
+        }
+    }
+
+    const auto params = DetectorParams();
+    Ptr<SimpleBlobDetector> simple = SimpleBlobDetector::create( params);
+    Detection::BlobFinder finder{ params};
+
+    std::cout << std::left << std::setw( 30) << "sample"
+              << std::right << std::setw( 12) << "simple (ms)" << std::setw( 12) << "finder (ms)"
+              << std::setw( 10) << "speedup" << std::setw( 10) << "count A" << std::setw( 10) << "count B"
+              << std::setw( 14) << "max dev (px)" << '\n';
+
+    for (const auto &sample : samples)
+    {
+        std::vector<KeyPoint> a;
+        std::vector<KeyPoint> b;
+        const double simpleTime = MillisecondsPerCall( [&]{ simple->detect( sample.mask, a);}, repetitions);
+        const double finderTime = MillisecondsPerCall( [&]{ finder.Detect( sample.mask, b);}, repetitions);
+
+        std::cout << std::left << std::setw( 30) << sample.name << std::right << std::fixed << std::setprecision( 3)
+                  << std::setw( 12) << simpleTime << std::setw( 12) << finderTime
+                  << std::setw( 10) << simpleTime / finderTime
+                  << std::setw( 10) << a.size() << std::setw( 10) << b.size()
+                  << std::setw( 14) << std::max( MaxDeviation( a, b), MaxDeviation( b, a)) << '\n';
+    }
+
+    return 0;
+}
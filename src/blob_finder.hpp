@@ -0,0 +1,259 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( BLOB_FINDER_HPP_)
+#define BLOB_FINDER_HPP_
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/features2d/features2d.hpp>
+
+namespace Detection
+{
+
+/// Find bright blobs in a binary (0/255) image.
+///
+/// This applies the same area, circularity, convexity, colour and minimum distance filters as
+/// cv::SimpleBlobDetector and returns the same key points for binary images. SimpleBlobDetector thresholds its
+/// input once for every threshold step and runs findContours() on the complete image for each of them, which
+/// for an image that is already binary just produces the same contours over and over. This class labels the image
+/// once with connectedComponentsWithStats() and then only traces the outline of components that are large enough,
+/// inside their own bounding box.
+///
+/// Threshold, repeatability and inertia parameters are ignored.
+class BlobFinder
+{
+public:
+    typedef cv::SimpleBlobDetector::Params Params;
+
+    explicit BlobFinder( const Params &params = Params())
+    {
+        SetParams( params);
+    }
+
+    void SetParams( const Params &params)
+    {
+        CV_Assert( !params.filterByColor || params.blobColor != 0);
+        m_params = params;
+    }
+
+    /// The properties of one component of a binary image, measured before any of the filters are applied.
+    /// Candidates can be kept and filtered again later with different area, distance or shape parameters.
+    struct Candidate
+    {
+        cv::Point2d location;
+        double      radius;
+        double      area;
+        double      perimeter;
+        double      hullArea;
+        bool        centerLit;
+    };
+
+    void Detect( const cv::Mat &binaryImage, std::vector<cv::KeyPoint> &keypoints)
+    {
+        FindCandidates( binaryImage, m_params.filterByArea ? m_params.minArea : 0.0, m_candidates);
+        Select( m_candidates, keypoints);
+    }
+
+    /// Measure all components in a binary image that have at least minPixels pixels.
+    ///
+    /// The area inside a traced contour is never larger than the number of pixels of the component, so for any
+    /// minArea >= minPixels the skipped components would not have passed the area filter anyway.
+    void FindCandidates( const cv::Mat &binaryImage, double minPixels, std::vector<Candidate> &candidates)
+    {
+        candidates.clear();
+
+        const int count = cv::connectedComponentsWithStats( binaryImage, m_labels, m_stats, m_centroids, 8, CV_32S);
+
+        // label 0 is the background.
+        for (int label = 1; label < count; ++label)
+        {
+            const int *stats = m_stats.ptr<int>( label);
+            if (stats[cv::CC_STAT_AREA] < minPixels) continue;
+
+            const cv::Rect box{
+                stats[cv::CC_STAT_LEFT], stats[cv::CC_STAT_TOP],
+                stats[cv::CC_STAT_WIDTH], stats[cv::CC_STAT_HEIGHT]};
+
+            Candidate candidate;
+            if (Measure( binaryImage, label, box, candidate))
+            {
+                candidates.push_back( candidate);
+            }
+        }
+    }
+
+    /// Apply the filters to a set of candidates and emit one key point per (merged) blob.
+    void Select( const std::vector<Candidate> &candidates, std::vector<cv::KeyPoint> &keypoints)
+    {
+        keypoints.clear();
+        m_blobs.clear();
+        for (const auto &candidate : candidates)
+        {
+            if (Passes( candidate))
+            {
+                m_blobs.push_back( Blob{ candidate.location, candidate.radius, Circularity( candidate), 0});
+            }
+        }
+
+        Merge( keypoints);
+    }
+
+private:
+    struct Blob
+    {
+        cv::Point2d location;
+        double      radius;
+        double      circularity;
+        size_t      group;
+    };
+
+    static double Circularity( const Candidate &candidate)
+    {
+        return candidate.perimeter > 0.0 ? 4 * CV_PI * candidate.area / (candidate.perimeter * candidate.perimeter) : 0.0;
+    }
+
+    /// Trace the outline of one component and measure it.
+    /// Returns false if the component has no outline.
+    bool Measure( const cv::Mat &binaryImage, int label, const cv::Rect &box, Candidate &candidate)
+    {
+        // copy only this component into a buffer with a one pixel border, so that neighbouring components
+        // in the bounding box do not show up in the contour.
+        m_component.create( box.height + 2, box.width + 2, CV_8UC1);
+        m_component = cv::Scalar( 0);
+        cv::Mat inner = m_component( cv::Rect( 1, 1, box.width, box.height));
+        cv::compare( m_labels( box), label, inner, cv::CMP_EQ);
+
+        m_contours.clear();
+        cv::findContours( m_component, m_contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_NONE,
+                cv::Point( box.x - 1, box.y - 1));
+        if (m_contours.empty()) return false;
+        const auto &contour = m_contours[0];
+
+        const cv::Moments moms = cv::moments( contour);
+        candidate.area = moms.m00;
+        candidate.perimeter = cv::arcLength( contour, true);
+        cv::convexHull( contour, m_hull);
+        candidate.hullArea = cv::contourArea( m_hull);
+        candidate.radius = 0.0;
+        candidate.centerLit = false;
+
+        if (moms.m00 == 0.0) return true;
+
+        candidate.location = cv::Point2d( moms.m10 / moms.m00, moms.m01 / moms.m00);
+        candidate.centerLit =
+                binaryImage.at<uchar>( cvRound( candidate.location.y), cvRound( candidate.location.x)) != 0;
+
+        // the radius is the median distance of the contour to the center.
+        m_distances.clear();
+        for (const auto &point : contour)
+        {
+            m_distances.push_back( cv::norm( candidate.location - cv::Point2d( point.x, point.y)));
+        }
+        std::sort( m_distances.begin(), m_distances.end());
+        candidate.radius = (m_distances[(m_distances.size() - 1) / 2] + m_distances[m_distances.size() / 2]) / 2.0;
+
+        return true;
+    }
+
+    /// Apply the filters in the same order and with the same comparisons as SimpleBlobDetector.
+    bool Passes( const Candidate &candidate) const
+    {
+        if (m_params.filterByArea)
+        {
+            if (candidate.area < m_params.minArea || candidate.area >= m_params.maxArea) return false;
+        }
+
+        if (m_params.filterByCircularity)
+        {
+            const double ratio = 4 * CV_PI * candidate.area / (candidate.perimeter * candidate.perimeter);
+            if (ratio < m_params.minCircularity || ratio >= m_params.maxCircularity) return false;
+        }
+
+        if (m_params.filterByConvexity)
+        {
+            if (std::fabs( candidate.hullArea) < DBL_EPSILON) return false;
+            const double ratio = candidate.area / candidate.hullArea;
+            if (ratio < m_params.minConvexity || ratio >= m_params.maxConvexity) return false;
+        }
+
+        if (candidate.area == 0.0) return false;
+
+        return !m_params.filterByColor || candidate.centerLit;
+    }
+
+    /// Merge blobs that are too close to each other, like SimpleBlobDetector merges the centers it finds at
+    /// different thresholds, and emit one key point per group.
+    /// Unlike SimpleBlobDetector, the response of a key point is set: it is the mean circularity of the group,
+    /// clamped to 1, which is 1 for a perfect disc and gets lower for less LED-like shapes.
+    void Merge( std::vector<cv::KeyPoint> &keypoints)
+    {
+        for (size_t i = 0; i < m_blobs.size(); ++i)
+        {
+            auto &blob = m_blobs[i];
+            blob.group = i;
+            for (size_t j = 0; j < i; ++j)
+            {
+                const auto &first = m_blobs[j];
+                if (first.group != j) continue;
+
+                const double dist = cv::norm( first.location - blob.location);
+                if (dist < m_params.minDistBetweenBlobs || dist < first.radius || dist < blob.radius)
+                {
+                    blob.group = j;
+                    break;
+                }
+            }
+        }
+
+        for (size_t group = 0; group < m_blobs.size(); ++group)
+        {
+            if (m_blobs[group].group != group) continue;
+
+            cv::Point2d sum( 0, 0);
+            double circularity = 0.0;
+            m_distances.clear(); // re-used for the radii of the group members
+            for (size_t i = group; i < m_blobs.size(); ++i)
+            {
+                if (m_blobs[i].group == group)
+                {
+                    sum += m_blobs[i].location;
+                    circularity += m_blobs[i].circularity;
+                    m_distances.push_back( m_blobs[i].radius);
+                }
+            }
+            std::sort( m_distances.begin(), m_distances.end());
+
+            const double members = static_cast<double>( m_distances.size());
+            keypoints.push_back( cv::KeyPoint(
+                    cv::Point2f( static_cast<float>( sum.x / members), static_cast<float>( sum.y / members)),
+                    static_cast<float>( m_distances[m_distances.size() / 2] * 2.0),
+                    -1.0f,
+                    static_cast<float>( std::min( circularity / members, 1.0))));
+        }
+    }
+
+    Params m_params;
+
+    // workspace, kept between calls to avoid allocations.
+    cv::Mat m_labels;
+    cv::Mat m_stats;
+    cv::Mat m_centroids;
+    cv::Mat m_component;
+    std::vector<std::vector<cv::Point>> m_contours;
+    std::vector<cv::Point> m_hull;
+    std::vector<double> m_distances;
+    std::vector<Candidate> m_candidates;
+    std::vector<Blob> m_blobs;
+};
+
+}
+#endif //BLOB_FINDER_HPP_
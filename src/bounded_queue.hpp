@@ -0,0 +1,78 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( BOUNDED_QUEUE_HPP_)
+#define BOUNDED_QUEUE_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <utility>
+
+namespace Detection
+{
+
+/// A thread-safe FIFO queue with a maximum size.
+///
+/// Push() blocks while the queue is full and Pop() blocks while it is empty. After Close(), Push() no longer accepts
+/// items and Pop() returns false once the remaining items have been taken.
+template<typename T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue( std::size_t capacity)
+    : m_capacity( capacity ? capacity : 1)
+    {
+    }
+
+    /// Add an item to the queue, waiting for room if necessary.
+    /// Returns false if the queue was closed.
+    bool Push( T item)
+    {
+        std::unique_lock<std::mutex> lock( m_mutex);
+        m_notFull.wait( lock, [this]{ return m_closed || m_items.size() < m_capacity;});
+        if (m_closed) return false;
+
+        m_items.push_back( std::move( item));
+        m_notEmpty.notify_one();
+        return true;
+    }
+
+    /// Take the next item from the queue, waiting for one if necessary.
+    /// Returns false if the queue was closed and no items are left.
+    bool Pop( T &item)
+    {
+        std::unique_lock<std::mutex> lock( m_mutex);
+        m_notEmpty.wait( lock, [this]{ return m_closed || !m_items.empty();});
+        if (m_items.empty()) return false;
+
+        item = std::move( m_items.front());
+        m_items.pop_front();
+        m_notFull.notify_one();
+        return true;
+    }
+
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock( m_mutex);
+        m_closed = true;
+        m_notEmpty.notify_all();
+        m_notFull.notify_all();
+    }
+
+private:
+    const std::size_t       m_capacity;
+    std::deque<T>           m_items;
+    bool                    m_closed = false;
+    std::mutex              m_mutex;
+    std::condition_variable m_notEmpty;
+    std::condition_variable m_notFull;
+};
+
+}
+#endif //BOUNDED_QUEUE_HPP_
@@ -0,0 +1,59 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( CHANNEL_DETECTOR_HPP_)
+#define CHANNEL_DETECTOR_HPP_
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "blob_finder.hpp"
+#include "red_difference.hpp"
+
+namespace Detection
+{
+
+/// Find the blobs that light up in one colour channel between a reference frame and the current frame.
+///
+/// This is the difference, blur, threshold and blob pipeline of the LED detector, for any of the three channels.
+class ChannelDetector
+{
+public:
+    struct Params
+    {
+        int                 blurValue;
+        int                 lowerThreshold;
+        int                 upperThreshold;
+        BlobFinder::Params  blobs;
+    };
+
+    explicit ChannelDetector( const Params &params)
+    : m_params( params), m_finder( params.blobs)
+    {
+    }
+
+    /// Find blobs in channel 'channel' (0: blue, 1: green, 2: red) of current - reference.
+    void Detect( const cv::Mat &current, const cv::Mat &reference, int channel, std::vector<cv::KeyPoint> &blobs)
+    {
+        const int kernel = 1 + 2 * m_params.blurValue;
+        ChannelDifference( current, reference, channel, m_difference);
+        cv::GaussianBlur( m_difference, m_blurred, cv::Size{ kernel, kernel}, 0);
+        cv::inRange( m_blurred, cv::Scalar( m_params.lowerThreshold), cv::Scalar( m_params.upperThreshold), m_mask);
+        m_finder.Detect( m_mask, blobs);
+    }
+
+private:
+    Params      m_params;
+    BlobFinder  m_finder;
+    cv::Mat     m_difference;
+    cv::Mat     m_blurred;
+    cv::Mat     m_mask;
+};
+
+}
+#endif //CHANNEL_DETECTOR_HPP_
@@ -0,0 +1,140 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( COLOR_SEQUENCE_DECODER_HPP_)
+#define COLOR_SEQUENCE_DECODER_HPP_
+#include <cstddef>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+#include "channel_detector.hpp"
+
+namespace Detection
+{
+
+/// Decoder for the color_registration() sequence of the AVR registration code.
+///
+/// In that sequence, frame k lights LED 3k in pure red, LED 3k + 1 in pure green and LED 3k + 2 in pure blue,
+/// with dark frames in between. The decoder runs the difference, blur and blob stages on each colour channel
+/// separately and assigns the single blob of every channel to the LED of that colour. A frame in which at least one
+/// channel has a single blob counts as a group; the channels of that frame without exactly one blob register no LED.
+///
+/// As with the simple sequence, a frame with many blobs (the all-on frame at the start of the sequence)
+/// restarts the registration.
+class ColorSequenceDecoder
+{
+public:
+    ColorSequenceDecoder( const ChannelDetector::Params &params, std::size_t resetCount)
+    : m_detector( params), m_resetCount( resetCount)
+    {
+    }
+
+    /// Decode a complete video.
+    /// Returns the LED positions, sorted on LED index, with the index in the class_id of every key point.
+    std::vector<cv::KeyPoint> Decode( cv::VideoCapture &video)
+    {
+        Reset();
+        cv::Mat frame;
+        while (video.read( frame))
+        {
+            Feed( frame);
+        }
+        return Result();
+    }
+
+    void Reset()
+    {
+        m_leds.clear();
+        m_group = 0;
+        m_frames = 0;
+        m_skipNext = false;
+        m_previous.release();
+    }
+
+    /// Process the next frame of the video.
+    void Feed( const cv::Mat &frame)
+    {
+        ++m_frames;
+
+        // the frame after a detection may still show the LEDs switching off, so it only serves as
+        // the next reference frame.
+        if (m_previous.empty() || m_skipNext)
+        {
+            frame.copyTo( m_previous);
+            m_skipNext = false;
+            return;
+        }
+
+        m_skipNext = Analyse( frame);
+        frame.copyTo( m_previous);
+    }
+
+    /// LED positions found so far, sorted on LED index.
+    const std::vector<cv::KeyPoint> &Result() const
+    {
+        return m_leds;
+    }
+
+    /// Number of frames fed to the decoder.
+    std::size_t GetFrameCount() const
+    {
+        return m_frames;
+    }
+
+private:
+    /// Find the blobs of all three colours in frame, compared to the previous frame.
+    /// Returns true if this frame showed a group of LEDs.
+    bool Analyse( const cv::Mat &frame)
+    {
+        static const int channels[ColorCount] = { 2, 1, 0}; // red, green and blue in a BGR image.
+
+        bool found = false;
+        for (int color = 0; color < ColorCount; ++color)
+        {
+            m_detector.Detect( frame, m_previous, channels[color], m_blobs[color]);
+            if (m_blobs[color].size() > m_resetCount)
+            {
+                m_leds.clear();
+                m_group = 0;
+                return false;
+            }
+            found = found || m_blobs[color].size() == 1;
+        }
+
+        if (!found) return false;
+
+        // a channel with several blobs (a reflection, or noise in one colour) only loses its own LED, the group
+        // still advances so that the LEDs after it keep their index.
+        for (int color = 0; color < ColorCount; ++color)
+        {
+            if (m_blobs[color].size() == 1)
+            {
+                cv::KeyPoint led = m_blobs[color].front();
+                led.class_id = static_cast<int>( ColorCount * m_group + color);
+                m_leds.push_back( led);
+            }
+        }
+        ++m_group;
+        return true;
+    }
+
+    static const int ColorCount = 3;
+
+    ChannelDetector             m_detector;
+    std::size_t                 m_resetCount;   // a channel with more blobs than this restarts the registration
+    std::vector<cv::KeyPoint>   m_leds;
+    std::vector<cv::KeyPoint>   m_blobs[ColorCount];
+    std::size_t                 m_group = 0;
+    std::size_t                 m_frames = 0;
+    bool                        m_skipNext = false;
+    cv::Mat                     m_previous;
+};
+
+}
+#endif //COLOR_SEQUENCE_DECODER_HPP_
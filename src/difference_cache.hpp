@@ -0,0 +1,126 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( DIFFERENCE_CACHE_HPP_)
+#define DIFFERENCE_CACHE_HPP_
+#include <cstddef>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace Detection
+{
+
+/// A size-limited in-memory store of per-frame images of one video, e.g. the red-channel differences of
+/// consecutive frames.
+///
+/// Image k belongs to the pair of frames (k, k + 1). Images can be stored in any order, but once the size limit has
+/// been reached no more images are accepted and the remaining frames will have to be decoded from the video again.
+class DifferenceCache
+{
+public:
+    explicit DifferenceCache( std::size_t maxBytes = 0)
+    : m_maxBytes( maxBytes)
+    {
+    }
+
+    /// Change the size limit. If the cache is larger than the new limit, the last images are dropped.
+    void SetLimit( std::size_t maxBytes)
+    {
+        m_maxBytes = maxBytes;
+        m_full = false;
+        while (m_bytes > m_maxBytes)
+        {
+            m_bytes -= Bytes( m_images.back());
+            m_images.pop_back();
+            m_full = true;
+        }
+    }
+
+    void Clear()
+    {
+        m_images.clear();
+        m_bytes = 0;
+        m_full = false;
+    }
+
+    /// Drop all images from image 'count' on, so that they can be stored again.
+    void Truncate( std::size_t count)
+    {
+        while (m_images.size() > count)
+        {
+            m_bytes -= Bytes( m_images.back());
+            m_images.pop_back();
+        }
+        m_full = false;
+    }
+
+    bool Has( std::size_t index) const
+    {
+        return index < m_images.size() && !m_images[index].empty();
+    }
+
+    /// Return whether Add() would store an image with the given index.
+    /// Callers can use this to avoid computing images that would not be stored anyway.
+    bool Wants( std::size_t index) const
+    {
+        return !m_full && !Has( index);
+    }
+
+    /// Store a copy of image 'index', if it is not already there and if it still fits.
+    /// Every stored image has a buffer of its own, so every image that is stored costs one allocation.
+    void Add( std::size_t index, const cv::Mat &image)
+    {
+        if (!Wants( index)) return;
+
+        const std::size_t bytes = Bytes( image);
+        if (m_bytes + bytes > m_maxBytes)
+        {
+            m_full = true;
+            return;
+        }
+
+        if (index >= m_images.size())
+        {
+            m_images.resize( index + 1);
+        }
+        m_images[index] = image.clone();
+        m_bytes += bytes;
+        ++m_allocations;
+    }
+
+    std::size_t GetBytes() const
+    {
+        return m_bytes;
+    }
+
+    /// Number of images that were copied into the cache so far, each in a newly allocated buffer.
+    std::size_t GetAllocations() const
+    {
+        return m_allocations;
+    }
+
+    const cv::Mat &operator[]( std::size_t index) const
+    {
+        return m_images[index];
+    }
+
+private:
+    static std::size_t Bytes( const cv::Mat &image)
+    {
+        return image.total() * image.elemSize();
+    }
+
+    std::vector<cv::Mat> m_images;
+    std::size_t m_maxBytes;
+    std::size_t m_bytes = 0;
+    std::size_t m_allocations = 0;
+    bool m_full = false;
+};
+
+}
+#endif //DIFFERENCE_CACHE_HPP_
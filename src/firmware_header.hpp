@@ -0,0 +1,230 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( FIRMWARE_HEADER_HPP_)
+#define FIRMWARE_HEADER_HPP_
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+
+namespace Detection
+{
+
+/// Scale LED positions so that their bounding box spans 0..255 in both directions.
+inline std::vector<cv::Point2f> NormalisedPositions( const std::vector<cv::KeyPoint> &leds)
+{
+    std::vector<cv::Point2f> positions;
+    if (leds.empty()) return positions;
+
+    cv::Point2f lowerLeft = leds[0].pt;
+    cv::Point2f upperRight = leds[0].pt;
+    for (const auto &led : leds)
+    {
+        lowerLeft.x = std::min( lowerLeft.x, led.pt.x);
+        lowerLeft.y = std::min( lowerLeft.y, led.pt.y);
+        upperRight.x = std::max( upperRight.x, led.pt.x);
+        upperRight.y = std::max( upperRight.y, led.pt.y);
+    }
+
+    const float xRange = upperRight.x - lowerLeft.x;
+    const float yRange = upperRight.y - lowerLeft.y;
+    for (const auto &led : leds)
+    {
+        positions.push_back( cv::Point2f(
+                xRange > 0 ? 255 * ((led.pt.x - lowerLeft.x) / xRange) : 0,
+                yRange > 0 ? 255 * ((led.pt.y - lowerLeft.y) / yRange) : 0));
+    }
+    return positions;
+}
+
+/// Parse centre points in the form "x,y;x,y;..." in normalised (0..255) coordinates.
+inline std::vector<cv::Point2f> ParseCentres( const std::string &text)
+{
+    std::vector<cv::Point2f> centres;
+    std::istringstream input{ text};
+    std::string point;
+    while (std::getline( input, point, ';'))
+    {
+        std::istringstream coordinates{ point};
+        cv::Point2f centre;
+        char comma = 0;
+        if (!(coordinates >> centre.x >> comma >> centre.y) || comma != ',')
+        {
+            throw std::runtime_error( "Can't read centre point \"" + point + "\", expected x,y");
+        }
+        centres.push_back( centre);
+    }
+    return centres;
+}
+
+/// Write a C++ header for the AVR demo code with the LED positions and distance tables in program memory.
+///
+/// The header defines, in namespace led_positions:
+///  - led_count,
+///  - position8[]: positions in 0..255,
+///  - position16[]: the same positions in 8.8 fixed point (if withPosition16, and always for more than 255 LEDs),
+///  - x_order[], x_cells[] and index: the LEDs sorted on x, with the first entry of every cell of 16 x-values,
+///    for effects that only visit the LEDs in part of the area (see led_index in position.hpp). For more than 255
+///    LEDs the index uses position16, so that LEDs that are close together keep different coordinates,
+///    and index_table is its type,
+///  - centres[] and distancesN[]: for every centre point, the distance of every LED to that centre, scaled so that
+///    the farthest LED is at 255.
+/// The Position8 and Position16 types come from the hand-written position.hpp of the demo code.
+class FirmwareHeader
+{
+public:
+    FirmwareHeader( const std::vector<cv::KeyPoint> &leds, const std::vector<cv::Point2f> &centres, bool withPosition16)
+    : m_positions( NormalisedPositions( leds)), m_centres( centres),
+      m_withPosition16( withPosition16 || leds.size() > 255)
+    {
+    }
+
+    void Write( std::ostream &output, const std::string &source) const
+    {
+        output << "//\n// LED positions of " << source << ", generated by LedMapping --header.\n"
+               << "// Regenerate this file instead of editing it.\n//\n"
+               << "#if !defined( LED_POSITIONS_HPP_)\n#define LED_POSITIONS_HPP_\n"
+               << "#include <stdint.h>\n#include <avr/pgmspace.h>\n#include \"position.hpp\"\n\n"
+               << "namespace led_positions {\n\n"
+               << "const uint16_t led_count = " << m_positions.size() << ";\n\n";
+
+        output << "const Position8 PROGMEM position8[] = {\n";
+        for (const auto &position : m_positions)
+        {
+            output << "        { " << Byte( position.x) << ", " << Byte( position.y) << "},\n";
+        }
+        output << "};\n";
+
+        if (m_withPosition16)
+        {
+            output << "\n// 8.8 fixed point\nconst Position16 PROGMEM position16[] = {\n";
+            for (const auto &position : m_positions)
+            {
+                output << "        { " << Fixed( position.x) << ", " << Fixed( position.y) << "},\n";
+            }
+            output << "};\n";
+        }
+
+        WriteIndex( output);
+
+        if (!m_centres.empty())
+        {
+            output << "\nconst uint8_t centre_count = " << m_centres.size() << ";\n"
+                   << "const Position8 PROGMEM centres[] = {\n";
+            for (const auto &centre : m_centres)
+            {
+                output << "        { " << Byte( centre.x) << ", " << Byte( centre.y) << "},\n";
+            }
+            output << "};\n";
+        }
+
+        for (std::size_t centre = 0; centre < m_centres.size(); ++centre)
+        {
+            output << "\n// distance to centre " << centre << ", the farthest LED is at 255.\n"
+                   << "const uint8_t PROGMEM distances" << centre << "[] = {";
+            const auto distances = Distances( m_centres[centre]);
+            for (std::size_t led = 0; led < distances.size(); ++led)
+            {
+                output << (led % 16 ? " " : "\n        ") << static_cast<int>( distances[led]) << ',';
+            }
+            output << "\n};\n";
+        }
+
+        output << "\n}\n#endif //LED_POSITIONS_HPP_\n";
+    }
+
+private:
+    /// The cell width must match x_cell_shift in position.hpp.
+    static const int CellShift = 4;
+
+    void WriteIndex( std::ostream &output) const
+    {
+        // sorted on the fixed point x, which also sorts on the 8-bit x.
+        std::vector<std::size_t> order( m_positions.size());
+        for (std::size_t led = 0; led < order.size(); ++led) order[led] = led;
+        std::stable_sort( order.begin(), order.end(),
+                [this]( std::size_t left, std::size_t right)
+                { return Fixed( m_positions[left].x) < Fixed( m_positions[right].x);});
+
+        output << "\n// LEDs sorted on x, and the first entry in x_order of every cell of " << (1 << CellShift)
+               << " x-values.\nconst " << IndexType() << " PROGMEM x_order[] = {";
+        for (std::size_t entry = 0; entry < order.size(); ++entry)
+        {
+            output << (entry % 16 ? " " : "\n        ") << order[entry] << ',';
+        }
+        output << "\n};\nconst " << IndexType() << " PROGMEM x_cells[] = {\n       ";
+
+        std::size_t entry = 0;
+        for (int cell = 0; cell <= (256 >> CellShift); ++cell)
+        {
+            while (entry < order.size() && Cell( m_positions[order[entry]].x) < cell) ++entry;
+            output << ' ' << entry << ',';
+        }
+        output << "\n};\n\ntypedef led_index<" << IndexType() << (Wide() ? ", uint16_t" : "") << "> index_table;\n"
+               << "const index_table index = { " << (Wide() ? "position16" : "position8")
+               << ", x_order, x_cells, led_count};\n";
+    }
+
+    /// True if the LED index has 16-bit entries and uses the 8.8 fixed point positions.
+    bool Wide() const
+    {
+        return m_positions.size() > 255;
+    }
+
+    /// The cell of x_cells of an x-coordinate, like x_cell() in position.hpp.
+    int Cell( float x) const
+    {
+        return Wide() ? Fixed( x) >> (CellShift + 8) : Byte( x) >> CellShift;
+    }
+
+    /// The type of the LED indices, like led_index_type in position.hpp.
+    const char *IndexType() const
+    {
+        return Wide() ? "uint16_t" : "uint8_t";
+    }
+
+    std::vector<unsigned char> Distances( const cv::Point2f &centre) const
+    {
+        std::vector<double> distances;
+        double farthest = 0.0;
+        for (const auto &position : m_positions)
+        {
+            distances.push_back( cv::norm( position - centre));
+            farthest = std::max( farthest, distances.back());
+        }
+
+        std::vector<unsigned char> scaled;
+        for (const double distance : distances)
+        {
+            scaled.push_back( static_cast<unsigned char>( farthest > 0 ? std::lround( 255 * distance / farthest) : 0));
+        }
+        return scaled;
+    }
+
+    static int Byte( float value)
+    {
+        return std::min( std::max( static_cast<int>( value), 0), 255);
+    }
+
+    static long Fixed( float value)
+    {
+        return std::min( std::max( std::lround( value * 256), 0L), 65535L);
+    }
+
+    std::vector<cv::Point2f> m_positions;
+    std::vector<cv::Point2f> m_centres;
+    bool m_withPosition16;
+};
+
+}
+#endif //FIRMWARE_HEADER_HPP_
@@ -0,0 +1,122 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( GAUSSIAN_FIT_HPP_)
+#define GAUSSIAN_FIT_HPP_
+#include <cmath>
+#include <opencv2/core/core.hpp>
+
+#include "nm_simplex_solver.hpp"
+
+namespace Detection
+{
+
+/// Result of fitting a 2D Gaussian to an image patch.
+struct GaussianFit
+{
+    cv::Point2f centre;     ///< in patch coordinates
+    double      sigma = 0.0;
+    double      amplitude = 0.0;
+    double      cost = 0.0; ///< sum of squared differences between the model and the patch
+    unsigned int iterations = 0;
+    bool        valid = false;
+};
+
+/// Sum of squared differences between A * exp( -((x - x0)^2 + (y - y0)^2) / (2 sigma^2)) and a single channel 8-bit
+/// patch, as a function of (x0, y0, sigma, A).
+class GaussianCost
+{
+public:
+    typedef Solvers::ArrayPoints<4>::Point Point;
+    enum { X, Y, Sigma, Amplitude};
+
+    explicit GaussianCost( const cv::Mat &patch)
+    : m_patch( &patch)
+    {
+        CV_Assert( patch.type() == CV_8UC1);
+    }
+
+    double operator()( const Point &p) const
+    {
+        const double sigma = p[Sigma];
+        if (sigma <= 0) return 1e30;
+        const double scale = -1.0 / (2 * sigma * sigma);
+        double sum = 0.0;
+        for (int y = 0; y < m_patch->rows; ++y)
+        {
+            const uchar *row = m_patch->ptr<uchar>( y);
+            const double dy2 = (y - p[Y]) * (y - p[Y]);
+            for (int x = 0; x < m_patch->cols; ++x)
+            {
+                const double error = p[Amplitude] * std::exp( ((x - p[X]) * (x - p[X]) + dy2) * scale) - row[x];
+                sum += error * error;
+            }
+        }
+        return sum;
+    }
+
+    /// The starting point of a fit: the given centre (in patch coordinates) and sigma, with the brightest pixel of
+    /// the patch as amplitude.
+    Point Start( const cv::Point2f &centre, double sigma) const
+    {
+        double maxValue = 0;
+        cv::minMaxLoc( *m_patch, nullptr, &maxValue);
+
+        Point start;
+        start[X] = centre.x;
+        start[Y] = centre.y;
+        start[Sigma] = sigma;
+        start[Amplitude] = maxValue;
+        return start;
+    }
+
+    /// Describe the solver result 'best'. The fit is only valid if the centre is inside the patch and sigma and
+    /// amplitude are positive.
+    GaussianFit Result( const Point &best, double cost, unsigned int iterations) const
+    {
+        GaussianFit fit;
+        fit.centre = cv::Point2f( static_cast<float>( best[X]), static_cast<float>( best[Y]));
+        fit.sigma = best[Sigma];
+        fit.amplitude = best[Amplitude];
+        fit.cost = cost;
+        fit.iterations = iterations;
+        fit.valid = fit.sigma > 0 && fit.amplitude > 0
+                && fit.centre.x >= 0 && fit.centre.x <= m_patch->cols - 1
+                && fit.centre.y >= 0 && fit.centre.y <= m_patch->rows - 1;
+        return fit;
+    }
+
+    /// the solver steps: one pixel for the centre, half a pixel for sigma and a few grey levels for the amplitude.
+    static Point Steps()
+    {
+        return Point{ { 1.0, 1.0, 0.5, 16.0}};
+    }
+
+    /// the solver epsilon: small compared to a single grey level over the whole patch.
+    static double Epsilon()
+    {
+        return 1e-3;
+    }
+
+private:
+    const cv::Mat *m_patch;
+};
+
+/// Fit a 2D Gaussian to a patch with the Nelder-Mead solver, starting at the given centre (in patch coordinates)
+/// and sigma.
+inline GaussianFit FitGaussian( const cv::Mat &patch, const cv::Point2f &centre, double sigma)
+{
+    const GaussianCost cost{ patch};
+    auto solver = Solvers::MakeSolver<4>( cost, 1.0, GaussianCost::Epsilon());
+    solver.SetSteps( GaussianCost::Steps());
+    const auto best = solver.FindMinimun( cost.Start( centre, sigma), 500);
+    return cost.Result( best, solver.GetLastCostValue(), solver.GetLastIterationCount());
+}
+
+}
+#endif //GAUSSIAN_FIT_HPP_
@@ -0,0 +1,303 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * End-to-end benchmark of the LED detection: runs the decoders of LedMapping on synthetic videos with known LED
+ * positions and reports the throughput and the position error.
+ *
+ * Without arguments this creates a set of synthetic videos in the current directory first. Otherwise the arguments
+ * are taken to be triplets <sequence> <video> <truth>, where truth is a file as written by SyntheticVideo.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "led_detector.hpp"
+#include "binary_pattern_decoder.hpp"
+#include "color_sequence_decoder.hpp"
+#include "synthetic_video.hpp"
+
+using namespace cv;
+namespace
+{
+    struct Scenario
+    {
+        std::string name;
+        Detection::SyntheticVideo::Sequence sequence;
+        std::string video;
+        std::string truth;
+    };
+
+    struct Measurement
+    {
+        unsigned int frames = 0;
+        double decodeSeconds = 0.0;   ///< time to only decode all frames of the video
+        double totalSeconds = 0.0;    ///< time to decode and analyse all frames
+        std::size_t found = 0;
+        std::size_t correct = 0;      ///< LEDs that were found at the position of the LED with the same index
+        double meanError = 0.0;       ///< in pixels, over the correct LEDs
+        double maxError = 0.0;
+    };
+
+    Scenario Generate( const std::string &name, const Detection::SyntheticVideo::Options &options)
+    {
+        const Scenario scenario{ name, options.sequence, "synthetic-" + name + ".avi", "synthetic-" + name + ".csv"};
+        const Detection::SyntheticVideo synthetic{ options};
+        synthetic.Write( scenario.video);
+        std::ofstream truth{ scenario.truth};
+        synthetic.WriteTruth( truth);
+        return scenario;
+    }
+
+    /// The default set of scenarios.
+    std::vector<Scenario> GenerateAll()
+    {
+        typedef Detection::SyntheticVideo Synthetic;
+        std::vector<Scenario> scenarios;
+
+        Synthetic::Options options;
+        scenarios.push_back( Generate( "simple-720p", options));
+
+        Synthetic::Options large = options;
+        large.resolution = Size{ 1920, 1080};
+        large.fps = 60;
+        scenarios.push_back( Generate( "simple-1080p-60", large));
+
+        Synthetic::Options noisy = options;
+        noisy.noise = 12;
+        noisy.blur = 3.5;
+        scenarios.push_back( Generate( "simple-noisy", noisy));
+
+        Synthetic::Options color = options;
+        color.sequence = Synthetic::Color;
+        scenarios.push_back( Generate( "color-720p", color));
+
+        Synthetic::Options binary = options;
+        binary.sequence = Synthetic::Binary;
+        scenarios.push_back( Generate( "binary-720p", binary));
+
+        // the AVR code repeats the sequence, the decoder must not read the second pass as more index bits.
+        Synthetic::Options repeated = binary;
+        repeated.repeat = 2;
+        scenarios.push_back( Generate( "binary-repeated", repeated));
+
+        return scenarios;
+    }
+
+    std::vector<Point2f> ReadTruth( const std::string &fileName)
+    {
+        std::ifstream file{ fileName};
+        if (!file)
+        {
+            throw std::runtime_error( "Can't open ground truth file " + fileName);
+        }
+
+        std::vector<Point2f> positions;
+        std::string line;
+        while (std::getline( file, line))
+        {
+            if (line.empty() || line[0] == '#') continue;
+            std::istringstream fields{ line};
+            std::size_t index;
+            char comma;
+            Point2f position;
+            if (fields >> index >> comma >> position.x >> comma >> position.y)
+            {
+                if (index >= positions.size()) positions.resize( index + 1);
+                positions[index] = position;
+            }
+        }
+        return positions;
+    }
+
+    /// Time to decode every frame of the video without looking at it.
+    double DecodeSeconds( const std::string &fileName, unsigned int &frames)
+    {
+        VideoCapture video{ fileName};
+        if (!video.isOpened())
+        {
+            throw std::runtime_error( "Can't open file " + fileName);
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        Mat frame;
+        frames = 0;
+        while (video.read( frame)) ++frames;
+        return std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+    }
+
+    /// Run the decoder for the sequence, return the LEDs in index order with their index in class_id.
+    std::vector<KeyPoint> Detect(
+            const Scenario &scenario,
+            const LedDetector::Settings &settings,
+            unsigned int threads)
+    {
+        typedef Detection::SyntheticVideo Synthetic;
+        std::vector<KeyPoint> results;
+        if (scenario.sequence == Synthetic::Simple)
+        {
+            LedDetector detector{ scenario.video, settings, false};
+            detector.SetThreads( threads);
+            detector.ScanSequence();
+            if (Detection::Profiler::IsEnabled())
+            {
+                std::cerr << scenario.name << ", subpixelFit=" << settings.subpixelFit << ":\n";
+                detector.GetProfile().Print( std::cerr);
+            }
+            results = detector.GetResults();
+            for (std::size_t index = 0; index < results.size(); ++index)
+            {
+                results[index].class_id = static_cast<int>( index);
+            }
+        }
+        else
+        {
+            VideoCapture video{ scenario.video};
+            if (!video.isOpened())
+            {
+                throw std::runtime_error( "Can't open file " + scenario.video);
+            }
+
+            if (scenario.sequence == Synthetic::Color)
+            {
+                Detection::ColorSequenceDecoder decoder{ LedDetector::ChannelParams( settings), static_cast<std::size_t>( settings.resetCount)};
+                results = decoder.Decode( video);
+            }
+            else if (scenario.sequence == Synthetic::Binary)
+            {
+                Detection::BinaryPatternDecoder decoder{
+                    LedDetector::ChannelParams( settings),
+                    static_cast<std::size_t>( settings.minPatternLeds),
+                    ReadTruth( scenario.truth).size()};
+                results = decoder.Decode( video);
+            }
+            else
+            {
+                throw std::runtime_error( "There is no decoder for the sequence of " + scenario.video);
+            }
+        }
+        return results;
+    }
+
+    Measurement Measure( const Scenario &scenario, const LedDetector::Settings &settings, unsigned int threads)
+    {
+        Measurement measurement;
+        measurement.decodeSeconds = DecodeSeconds( scenario.video, measurement.frames);
+
+        const auto start = std::chrono::steady_clock::now();
+        const auto results = Detect( scenario, settings, threads);
+        measurement.totalSeconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+
+        // an LED counts as correct if it is closer to the true position of its index than to any other LED.
+        const auto truth = ReadTruth( scenario.truth);
+        measurement.found = results.size();
+        double errorSum = 0.0;
+        for (const auto &led : results)
+        {
+            if (led.class_id < 0 || static_cast<std::size_t>( led.class_id) >= truth.size()) continue;
+            const double error = norm( led.pt - truth[led.class_id]);
+            const bool closest = std::none_of( truth.begin(), truth.end(),
+                    [&]( const Point2f &other) { return norm( led.pt - other) < error;});
+            if (closest)
+            {
+                ++measurement.correct;
+                errorSum += error;
+                measurement.maxError = std::max( measurement.maxError, error);
+            }
+        }
+        if (measurement.correct) measurement.meanError = errorSum / measurement.correct;
+
+        return measurement;
+    }
+
+    bool ParseScenarios( int argc, char **argv, std::vector<Scenario> &scenarios)
+    {
+        for (int arg = 1; arg + 2 < argc; arg += 3)
+        {
+            Scenario scenario{ argv[arg + 1], Detection::SyntheticVideo::Simple, argv[arg + 1], argv[arg + 2]};
+            if (!Detection::SyntheticVideo::ParseSequence( argv[arg], scenario.sequence)) return false;
+            scenarios.push_back( scenario);
+        }
+        return argc % 3 == 1;
+    }
+}
+
+int main( int argc, char **argv)
+{
+    try
+    {
+        std::vector<Scenario> scenarios;
+        if (argc > 1)
+        {
+            if (!ParseScenarios( argc, argv, scenarios))
+            {
+                std::cerr << "usage: LedBenchmark [<simple|color|binary> <video> <truth>]...\n";
+                return -1;
+            }
+        }
+        else
+        {
+            scenarios = GenerateAll();
+        }
+
+        const unsigned int threads = std::max( std::thread::hardware_concurrency(), 1u);
+        LedDetector::Settings settings;
+
+        std::cout << std::left << std::setw( 18) << "scenario" << std::setw( 9) << "subpixel"
+                  << std::right << std::setw( 8) << "frames" << std::setw( 12) << "decode fps"
+                  << std::setw( 12) << "total fps" << std::setw( 14) << "analyse (ms)"
+                  << std::setw( 8) << "found" << std::setw( 9) << "correct"
+                  << std::setw( 12) << "mean (px)" << std::setw( 10) << "max (px)" << '\n';
+
+        for (const auto &scenario : scenarios)
+        {
+            for (int subpixel : { 0, 1})
+            {
+                settings.subpixelFit = subpixel;
+                const Measurement result = Measure( scenario, settings, threads);
+                const double frames = std::max( result.frames, 1u);
+
+                std::cout << std::left << std::setw( 18) << scenario.name
+                          << std::setw( 9) << (subpixel ? "yes" : "no")
+                          << std::right << std::fixed << std::setprecision( 1)
+                          << std::setw( 8) << result.frames
+                          << std::setw( 12) << frames / result.decodeSeconds
+                          << std::setw( 12) << frames / result.totalSeconds
+                          << std::setprecision( 3)
+                          << std::setw( 14) << 1000.0 * (result.totalSeconds - result.decodeSeconds) / frames
+                          << std::setw( 8) << result.found << std::setw( 9) << result.correct
+                          << std::setw( 12) << result.meanError << std::setw( 10) << result.maxError << '\n';
+
+                // the sequence decoders do not refine positions, one row is enough for them.
+                if (scenario.sequence != Detection::SyntheticVideo::Simple) break;
+            }
+        }
+    }
+    catch( cv::Exception& e )
+    {
+        std::cerr << "OpenCV exception: " << e.what() << std::endl;
+        return -1;
+    }
+    catch( std::exception& e )
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,1248 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( LED_DETECTOR_HPP_)
+#define LED_DETECTOR_HPP_
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <exception>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "red_difference.hpp"
+#include "blob_finder.hpp"
+#include "channel_detector.hpp"
+#include "difference_cache.hpp"
+#include "bounded_queue.hpp"
+#include "gaussian_fit.hpp"
+#include "nm_batch_solver.hpp"
+#include "phase_lock.hpp"
+#include "pyramid_finder.hpp"
+#include "result_sink.hpp"
+#include "stage_profiler.hpp"
+
+void ShowTweaked( int, void*);
+
+/// Find the positions of the LEDs in a video of the simple_registration() sequence, in which the LEDs are lit
+/// one by one.
+class LedDetector
+{
+public:
+    /// Name of the window that shows the detected LEDs and the settings trackbars.
+    static const std::string &WindowName()
+    {
+        static const std::string name = "LED Finder";
+        return name;
+    }
+
+    struct Settings {
+        int minDist = 3;
+        int minArea = 70;
+        int maxArea = 3000;
+        int lowerThreshold = 65;
+        int upperThreshold = 255;
+        int lowerHue = 99;
+        int upperHue = 105;
+        int blurValue = 9;
+        int cropMargin = 50; ///< margin in pixels around the LEDs of the all-on frame, negative: don't crop
+        int pyramidLevels = 0; ///< find blobs at 1/2^pyramidLevels resolution first, 0: full resolution only
+        int refineTolerance = 4; ///< maximum distance in pixels between a coarse and a refined blob position
+        int phaseMargin = 0; ///< ms around each expected on-transition that is decoded after phase lock, 0: decode all
+        int subpixelFit = 0; ///< 1: refine LED positions by fitting a 2D Gaussian to the red difference, 0: blob centres
+        int resetCount = 8; ///< a frame with more blobs than this is the all-on frame, which restarts the registration
+        int minPatternLeds = 9; ///< a binary pattern frame has at least this many blobs
+
+        typedef std::pair<const char *, int Settings::*> Field;
+
+        /// All settings with the names that are used for them in settings files and on the command line.
+        static const std::vector<Field> &Fields()
+        {
+            static const std::vector<Field> fields = {
+                    { "minDist",        &Settings::minDist},
+                    { "minArea",        &Settings::minArea},
+                    { "maxArea",        &Settings::maxArea},
+                    { "lowerThreshold", &Settings::lowerThreshold},
+                    { "upperThreshold", &Settings::upperThreshold},
+                    { "lowerHue",       &Settings::lowerHue},
+                    { "upperHue",       &Settings::upperHue},
+                    { "blurValue",      &Settings::blurValue},
+                    { "cropMargin",     &Settings::cropMargin},
+                    { "pyramidLevels",  &Settings::pyramidLevels},
+                    { "refineTolerance",&Settings::refineTolerance},
+                    { "phaseMargin",    &Settings::phaseMargin},
+                    { "subpixelFit",    &Settings::subpixelFit},
+                    { "resetCount",     &Settings::resetCount},
+                    { "minPatternLeds", &Settings::minPatternLeds},
+            };
+            return fields;
+        }
+
+        bool operator==( const Settings &other) const
+        {
+            for (const auto &field : Fields())
+            {
+                if (this->*field.second != other.*field.second) return false;
+            }
+            return true;
+        }
+    };
+
+    /// Some numbers about the last call to ScanSequence().
+    struct ScanSummary {
+        unsigned int frames = 0;
+        double seconds = 0.0;
+        unsigned int allocations = 0; ///< number of times the frame buffers had to be (re-)allocated
+        /// number of difference and blur images copied into the caches, one allocation each. A single-threaded scan
+        /// allocates nothing else per frame, so without a cache (SetCacheLimit( 0)) it does not allocate per frame.
+        unsigned int cacheAllocations = 0;
+        unsigned int grabbedOnly = 0; ///< number of frames that were skipped without decoding them
+
+        double FramesPerSecond() const
+        {
+            return seconds > 0.0 ? frames / seconds : 0.0;
+        }
+    };
+
+    /// Create a detector for the given video file.
+    /// If interactive is false, the detector will not create any windows or call any other HighGUI function, which
+    /// means that it can run on machines without a display.
+    LedDetector( const std::string &fileName, const Settings &initialSettings, bool interactive)
+    :settings{ initialSettings}, m_fileName{ fileName}, m_interactive{ interactive}
+    {
+        if (m_interactive)
+        {
+            Setup();
+        }
+    }
+
+    /// Set the maximum number of bytes that may be used to keep the frame differences of the video in memory, and
+    /// the same number again for their blurred versions.
+    /// With a large enough cache, repeated scans (e.g. after changing a setting) do not need to decode the video again.
+    void SetCacheLimit( std::size_t bytes)
+    {
+        m_cache.SetLimit( bytes);
+        m_blurCache.SetLimit( bytes);
+    }
+
+    /// Set the number of threads to use while decoding. With more than one thread, one thread decodes the video
+    /// and the others analyse pairs of frames, while the calling thread merges the results in order.
+    void SetThreads( unsigned int threads)
+    {
+        m_threads = std::max( threads, 1u);
+    }
+
+    /// Emit every LED to 'sink' as soon as it is accepted, or stop emitting if sink is null.
+    /// The sink must outlive the scans.
+    void SetSink( Detection::ResultSink *sink)
+    {
+        m_sink = sink;
+    }
+
+    void ScanSequence( )
+    {
+        const auto start = std::chrono::steady_clock::now();
+        const auto allocations = m_workspace.allocations;
+        const auto cacheAllocations = m_cache.GetAllocations() + m_blurCache.GetAllocations();
+        unsigned int frames = 1;
+        m_grabbedOnly = 0;
+
+        m_foundLeds.clear();
+        m_foundPairs.clear();
+        m_profiler.Reset();
+        if (settings.cropMargin != m_regionMargin) UnlockRegion();
+        if (m_sink) m_sink->Reset();
+        if (m_interactive) ShowDetected();
+
+        // 'pair' is the index of the next pair of frames (pair, pair + 1) to analyse. As long as the blob
+        // candidates or the differences of those pairs are still around, there's no need to decode anything.
+        std::size_t pair = 0;
+        while (pair < m_pairCount)
+        {
+            bool found = false;
+            if (Memo( pair).IsValidFor( settings))
+            {
+                found = Accept( pair);
+                if (found && m_cache.Has( pair))
+                {
+                    RememberPatch( pair, m_cache[pair], AreaOf( pair, m_frameSize).tl());
+                }
+            }
+            else if (m_cache.Has( pair))
+            {
+                found = Analyse( pair, m_cache[pair]);
+            }
+            else
+            {
+                break;
+            }
+
+            const std::size_t step = found ? 2 : 1;
+            pair += step;
+            frames += step;
+        }
+
+        if (pair < m_pairCount || !m_pairCount)
+        {
+            frames = m_threads > 1 ? DecodeParallel( pair) : DecodeSequence( pair);
+        }
+
+        if (m_sink) m_sink->Finish( m_foundLeds.size());
+
+        if (settings.subpixelFit)
+        {
+            RefinePositions();
+        }
+
+        m_profiler.Count( Detection::FrameCounter, frames);
+        m_summary.frames = frames;
+        m_summary.allocations = m_workspace.allocations - allocations;
+        m_summary.cacheAllocations = static_cast<unsigned int>(
+                m_cache.GetAllocations() + m_blurCache.GetAllocations() - cacheAllocations);
+        m_summary.grabbedOnly = m_grabbedOnly;
+        m_summary.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start).count();
+
+        if (m_interactive)
+        {
+            std::cout << "Detected " << m_foundLeds.size() << "LEDs in " << m_summary.seconds << "s.\n";
+            ShowDetected();
+        }
+    }
+
+    void Setup()
+    {
+        cv::namedWindow(WindowName(), cv::WINDOW_AUTOSIZE);
+
+        cv::createTrackbar( "min distance",
+                        WindowName(), &settings.minDist,
+                        500, ShowTweaked, this);
+
+        cv::createTrackbar( "min Area",
+                        WindowName(), &settings.minArea,
+                        2000, ShowTweaked, this );
+        cv::createTrackbar( "max Area",
+                        WindowName(), &settings.maxArea,
+                        2000, ShowTweaked, this);
+
+        cv::createTrackbar( "lower Treshold",
+                        WindowName(), &settings.lowerThreshold,
+                        300, ShowTweaked, this);
+        cv::createTrackbar( "upper Threshold",
+                        WindowName(), &settings.upperThreshold,
+                        300, ShowTweaked, this);
+
+        cv::createTrackbar( "lower Hue",
+                        WindowName(), &settings.lowerHue,
+                        300, ShowTweaked, this);
+        cv::createTrackbar( "upper Hue",
+                        WindowName(), &settings.upperHue,
+                        300, ShowTweaked, this);
+        cv::createTrackbar( "blur",
+                        WindowName(), &settings.blurValue,
+                        10, ShowTweaked, this);
+
+    }
+
+    void Feed( const cv::Mat &current, const cv::Mat &previous)
+    {
+        m_current = current;
+        m_previous = previous;
+        Update();
+        if (m_interactive)
+        {
+            auto key = cv::waitKey(20);
+            std::cout << "received key: " << key << std::endl;
+        }
+    }
+
+    std::vector<cv::KeyPoint> GetResults() const
+    {
+        return m_foundLeds;
+    }
+
+    ScanSummary GetSummary() const
+    {
+        return m_summary;
+    }
+
+    /// Stage timings and counters of the last scan. These are only collected if LED_PROFILING is defined.
+    const Detection::Profiler &GetProfile() const
+    {
+        return m_profiler;
+    }
+
+    /// The blob detector parameters for the given settings.
+    static cv::SimpleBlobDetector::Params BlobParams( const Settings &current)
+    {
+        cv::SimpleBlobDetector::Params params;
+        params.minDistBetweenBlobs = current.minDist;
+        params.filterByInertia = false;
+
+        params.filterByConvexity = true;
+        params.minConvexity = 0.5;
+        params.maxConvexity = 1.1;
+
+        params.filterByColor = true;
+        params.blobColor = 255;
+
+        params.filterByArea = true;
+        params.minArea = current.minArea;
+        params.maxArea = current.maxArea;
+
+        params.filterByCircularity = true;
+        params.minCircularity = .5;
+        params.maxCircularity = 1.1;
+
+        return params;
+    }
+
+    /// The same settings in the form that the sequence decoders use.
+    static Detection::ChannelDetector::Params ChannelParams( const Settings &current)
+    {
+        return Detection::ChannelDetector::Params{
+            current.blurValue, current.lowerThreshold, current.upperThreshold, BlobParams( current)};
+    }
+
+    /// Find LEDs in the difference of m_current and m_previous, without remembering any intermediate results.
+    bool Update( )
+    {
+        auto &workspace = m_workspace;
+        workspace.Prepare( m_current.size());
+
+        {
+            Timed timed{ m_profiler, Detection::DifferenceStage};
+            Detection::RedDifference( m_current, m_previous, workspace.red);
+        }
+        {
+            Timed timed{ m_profiler, Detection::BlurStage};
+            cv::GaussianBlur( workspace.red, workspace.blurred, cv::Size{ 1 + 2 * settings.blurValue, 1 + 2 * settings.blurValue}, 0);
+        }
+        {
+            Timed timed{ m_profiler, Detection::ThresholdStage};
+            cv::inRange( workspace.blurred,
+                    cv::Scalar( settings.lowerThreshold),
+                    cv::Scalar( settings.upperThreshold),
+                    workspace.mask);
+        }
+
+        auto &features = workspace.features;
+        {
+            Timed timed{ m_profiler, Detection::BlobStage};
+            Detector().Detect( workspace.mask, features);
+        }
+        workspace.Verify();
+
+        return Register( features);
+    }
+
+    /// Find LEDs in the red-channel difference of pair of frames 'pair'.
+    /// The result of every stage is remembered, so that a later scan only has to redo the stages whose settings
+    /// changed.
+    bool Analyse( std::size_t pair, const cv::Mat &red)
+    {
+        auto &workspace = m_workspace;
+        workspace.Prepare( red.size());
+
+        auto &memo = Memo( pair);
+        if (!memo.IsValidFor( settings))
+        {
+            if (settings.pyramidLevels > 0)
+            {
+                // the pyramid search blurs and thresholds internally, it is timed as a whole.
+                Timed timed{ m_profiler, Detection::BlobStage};
+                m_pyramid.FindCandidates( red, PyramidParams( settings), Detector(), memo.candidates);
+            }
+            else
+            {
+                const cv::Mat &blurred = Blurred( pair, red);
+                {
+                    Timed timed{ m_profiler, Detection::ThresholdStage};
+                    cv::inRange( blurred,
+                            cv::Scalar( settings.lowerThreshold),
+                            cv::Scalar( settings.upperThreshold),
+                            workspace.mask);
+                }
+
+                Timed timed{ m_profiler, Detection::BlobStage};
+                Detector().FindCandidates( workspace.mask, settings.minArea, memo.candidates);
+            }
+            Shift( memo.candidates, AreaOf( pair, red.size()).tl());
+            memo.Remember( settings);
+            workspace.Verify();
+        }
+
+        const bool found = Accept( pair);
+        if (found)
+        {
+            Timed timed{ m_profiler, Detection::BookkeepingStage};
+            RememberPatch( pair, red, AreaOf( pair, red.size()).tl());
+        }
+        return found;
+    }
+
+    /// Apply the blob filters to the remembered candidates of a pair of frames.
+    bool Accept( std::size_t pair)
+    {
+        auto &features = m_workspace.features;
+        {
+            Timed timed{ m_profiler, Detection::BlobStage};
+            Detector().Select( Memo( pair).candidates, features);
+        }
+
+        Timed timed{ m_profiler, Detection::BookkeepingStage};
+        if (IsAllOn( features))
+        {
+            LockRegion( pair, features);
+        }
+        return Register( features, pair);
+    }
+
+    /// Add a detected LED to the results if exactly one was found.
+    /// 'pair' is the pair of frames that the features were found in, if known.
+    bool Register( const std::vector<cv::KeyPoint> &features, std::size_t pair = NoPair)
+    {
+        if (features.size() == 1)
+        {
+            m_foundLeds.push_back( features[0]);
+            m_foundPairs.push_back( pair);
+            m_profiler.Count( Detection::DetectionCounter);
+            if (m_sink) Emit( features[0], pair);
+        }
+        else if (IsAllOn( features))
+        {
+            m_foundLeds.clear();
+            m_foundPairs.clear();
+            m_profiler.Count( Detection::ResetCounter);
+            if (m_sink) m_sink->Reset();
+        }
+
+        return features.size() == 1;
+    }
+
+    /// True if the features are those of the frame in which all LEDs are lit.
+    bool IsAllOn( const std::vector<cv::KeyPoint> &features) const
+    {
+        return features.size() > static_cast<std::size_t>( settings.resetCount);
+    }
+
+    /// Send the LED that was just added to the results to the sink.
+    void Emit( const cv::KeyPoint &led, std::size_t pair)
+    {
+        // the LED is lit in the second frame of the pair.
+        const long frame = pair == NoPair ? -1 : static_cast<long>( pair + 1);
+        const double time = frame >= 0 && m_fps > 0 ? frame * 1000.0 / m_fps : -1.0;
+        m_sink->Led( Detection::LedRecord{ m_foundLeds.size() - 1, frame, time, led.pt, led.response});
+    }
+
+    void ShowDetected()
+    {
+        cv::Mat allFeatures;
+        cv::drawKeypoints( m_previous, m_foundLeds, allFeatures, cv::Scalar::all(-1),
+                cv::DrawMatchesFlags::DRAW_RICH_KEYPOINTS);
+        if (!m_region.empty() && !allFeatures.empty())
+        {
+            cv::rectangle( allFeatures, m_region, cv::Scalar( 0, 255, 0));
+        }
+        cv::imshow( WindowName(), allFeatures);
+    }
+
+private:
+    typedef std::vector<cv::KeyPoint> KeyPoints;
+    typedef Detection::Profiler::Scope Timed;
+
+    static const std::size_t NoPair = static_cast<std::size_t>( -1);
+
+    /// Part of the red difference around a detected LED, in frame coordinates.
+    struct Patch
+    {
+        cv::Rect rect;
+        cv::Mat red;
+    };
+
+    /// The blob candidates of one pair of frames, with the settings that they were computed with.
+    struct CandidateMemo
+    {
+        int blurValue = -1;
+        int lowerThreshold = -1;
+        int upperThreshold = -1;
+        int minPixels = 0;
+        int pyramidLevels = 0;
+        int refineTolerance = 0;
+        std::vector<Detection::BlobFinder::Candidate> candidates;
+
+        /// Candidates stay valid if the blur, threshold and pyramid settings are the same. Changing minArea is
+        /// fine, as long as no components were skipped that could pass with the new setting.
+        bool IsValidFor( const Settings &current) const
+        {
+            return current.blurValue == blurValue
+                    && current.lowerThreshold == lowerThreshold
+                    && current.upperThreshold == upperThreshold
+                    && current.minArea >= minPixels
+                    && current.pyramidLevels == pyramidLevels
+                    && (!pyramidLevels || current.refineTolerance == refineTolerance);
+        }
+
+        void Remember( const Settings &current)
+        {
+            blurValue = current.blurValue;
+            lowerThreshold = current.lowerThreshold;
+            upperThreshold = current.upperThreshold;
+            minPixels = current.minArea;
+            pyramidLevels = current.pyramidLevels;
+            refineTolerance = current.refineTolerance;
+        }
+    };
+
+    static Detection::PyramidFinder::Params PyramidParams( const Settings &current)
+    {
+        return Detection::PyramidFinder::Params{
+            current.pyramidLevels, current.blurValue,
+            current.lowerThreshold, current.upperThreshold,
+            static_cast<double>( current.minArea), static_cast<double>( current.refineTolerance)};
+    }
+
+    CandidateMemo &Memo( std::size_t pair)
+    {
+        if (pair >= m_memo.size())
+        {
+            m_memo.resize( pair + 1);
+        }
+        return m_memo[pair];
+    }
+
+    /// Return the blurred red difference of a pair of frames, from the cache if possible.
+    const cv::Mat &Blurred( std::size_t pair, const cv::Mat &red)
+    {
+        if (m_blurCacheValue != settings.blurValue)
+        {
+            m_blurCache.Clear();
+            m_blurCacheValue = settings.blurValue;
+        }
+
+        if (m_blurCache.Has( pair))
+        {
+            return m_blurCache[pair];
+        }
+
+        {
+            Timed timed{ m_profiler, Detection::BlurStage};
+            cv::GaussianBlur( red, m_workspace.blurred, cv::Size{ 1 + 2 * settings.blurValue, 1 + 2 * settings.blurValue}, 0);
+        }
+        Timed timed{ m_profiler, Detection::BookkeepingStage};
+        m_blurCache.Add( pair, m_workspace.blurred);
+        return m_workspace.blurred;
+    }
+
+    /// Once the frame in which all LEDs are lit has been seen, all LEDs will be inside the bounding box of the blobs in
+    /// that frame. From then on, only that part of the frames (plus a margin) needs to be analysed.
+    ///
+    /// Cached images and candidates of the pairs after 'pair' may have been computed on the whole frame by an earlier
+    /// scan. They are dropped, so that every cached image of a pair has its top-left corner at AreaOf( pair).tl()
+    /// and a re-scan finds the same candidates as a first scan.
+    void LockRegion( std::size_t pair, const KeyPoints &features)
+    {
+        if (!m_region.empty() || settings.cropMargin < 0 || m_frameSize.area() == 0) return;
+
+        cv::Rect box;
+        for (const auto &feature : features)
+        {
+            const int radius = cvCeil( feature.size / 2) + settings.cropMargin;
+            box |= cv::Rect{ cvFloor( feature.pt.x) - radius, cvFloor( feature.pt.y) - radius, 2 * radius + 1, 2 * radius + 1};
+        }
+
+        {
+            std::lock_guard<std::mutex> lock( m_regionMutex);
+            m_region = box & cv::Rect{ cv::Point{ 0, 0}, m_frameSize};
+            m_regionPair = pair;
+        }
+        m_regionMargin = settings.cropMargin;
+
+        DropAfter( pair);
+    }
+
+    /// Forget the region, for instance because it was built with another crop margin. The next scan locks it again
+    /// when it sees the frame in which all LEDs are lit.
+    void UnlockRegion()
+    {
+        std::size_t pair;
+        {
+            std::lock_guard<std::mutex> lock( m_regionMutex);
+            if (m_region.empty()) return;
+            m_region = cv::Rect{};
+            pair = m_regionPair;
+        }
+
+        DropAfter( pair);
+    }
+
+    /// Drop the cached images, candidates and patches of the pairs after 'pair', which were computed on another area
+    /// of the frames than the current region gives.
+    void DropAfter( std::size_t pair)
+    {
+        m_cache.Truncate( pair + 1);
+        m_blurCache.Truncate( pair + 1);
+        if (m_memo.size() > pair + 1) m_memo.resize( pair + 1);
+        m_patches.erase( m_patches.upper_bound( pair), m_patches.end());
+    }
+
+    /// The part of the frames that needs to be analysed for the given pair of frames.
+    /// Candidates are found in this area and need to be shifted by its top-left corner to get frame coordinates.
+    cv::Rect AreaOf( std::size_t pair, const cv::Size &frameSize) const
+    {
+        std::lock_guard<std::mutex> lock( m_regionMutex);
+        if (m_region.empty() || pair <= m_regionPair) return cv::Rect{ cv::Point{ 0, 0}, frameSize};
+        return m_region;
+    }
+
+    static void Shift( std::vector<Detection::BlobFinder::Candidate> &candidates, const cv::Point &offset)
+    {
+        for (auto &candidate : candidates)
+        {
+            candidate.location.x += offset.x;
+            candidate.location.y += offset.y;
+        }
+    }
+
+    /// The part of the frame around an LED that is used for the sub-pixel fit: twice the blob diameter.
+    cv::Rect PatchRect( const cv::KeyPoint &led) const
+    {
+        const int radius = cvCeil( led.size) + 2;
+        return cv::Rect{ cvFloor( led.pt.x) - radius, cvFloor( led.pt.y) - radius, 2 * radius + 1, 2 * radius + 1}
+                & cv::Rect{ cv::Point{ 0, 0}, m_frameSize};
+    }
+
+    /// True if the sub-pixel fit is enabled and the last LED, found in the given pair, has no patch yet.
+    bool WantsPatch( std::size_t pair) const
+    {
+        if (!settings.subpixelFit) return false;
+        const auto patch = m_patches.find( pair);
+        return patch == m_patches.end() || !patch->second.rect.contains( cv::Point( m_foundLeds.back().pt));
+    }
+
+    /// Remember the red difference around the LED that was just found in 'pair'.
+    /// 'red' is a difference image whose top-left corner is at 'offset' in the frame.
+    void RememberPatch( std::size_t pair, const cv::Mat &red, const cv::Point &offset)
+    {
+        if (!WantsPatch( pair)) return;
+        const cv::Rect rect = PatchRect( m_foundLeds.back()) & cv::Rect{ offset, red.size()};
+        if (rect.area() == 0) return;
+        m_patches[pair] = Patch{ rect, red( rect - offset).clone()};
+    }
+
+    /// Replace the blob centres of the found LEDs by the centres of 2D Gaussians fitted to their red difference.
+    /// All fits are solved as one batch on m_threads threads.
+    void RefinePositions()
+    {
+        std::vector<std::size_t> leds;      // index in m_foundLeds of every LED that has a patch
+        std::vector<const Patch *> patches;
+        for (std::size_t index = 0; index < m_foundLeds.size(); ++index)
+        {
+            const auto patch = m_patches.find( m_foundPairs[index]);
+            if (patch != m_patches.end() && patch->second.rect.contains( cv::Point( m_foundLeds[index].pt)))
+            {
+                leds.push_back( index);
+                patches.push_back( &patch->second);
+            }
+        }
+
+        Solvers::BatchPoints<4> starts{ leds.size()};
+        for (std::size_t problem = 0; problem < leds.size(); ++problem)
+        {
+            const auto &led = m_foundLeds[leds[problem]];
+            const cv::Point2f offset = patches[problem]->rect.tl();
+            starts.Set( problem, Detection::GaussianCost{ patches[problem]->red}.Start(
+                    led.pt - offset, std::max( led.size / 4, 1.0f)));
+        }
+
+        Solvers::WorkStealingPool pool{ m_threads};
+        const auto results = Solvers::SolveMany( pool, starts,
+                [&patches]( std::size_t problem) { return Detection::GaussianCost{ patches[problem]->red};},
+                Detection::GaussianCost::Steps(), Detection::GaussianCost::Epsilon(), 500);
+
+        for (std::size_t problem = 0; problem < leds.size(); ++problem)
+        {
+            auto &led = m_foundLeds[leds[problem]];
+            const auto fit = Detection::GaussianCost{ patches[problem]->red}.Result(
+                    results.positions.Get( problem), results.costs[problem], results.iterations[problem]);
+
+            // a fit that wanders off further than the blob radius has not found this LED.
+            const cv::Point2f centre = fit.centre + cv::Point2f( patches[problem]->rect.tl());
+            if (fit.valid && cv::norm( centre - led.pt) <= led.size / 2)
+            {
+                led.pt = centre;
+            }
+        }
+    }
+
+    /// Open the video and skip to the first frame of the given pair of frames.
+    /// Returns the number of frames skipped.
+    unsigned int OpenVideo( cv::VideoCapture &video, std::size_t pair) const
+    {
+        video.open( m_fileName);
+        if (!video.isOpened())
+        {
+            throw std::runtime_error(std::string{"Can't open file "} + m_fileName);
+        }
+
+        // the frames before 'pair' are not needed, so don't bother retrieving them.
+        unsigned int frames = 0;
+        while (frames < pair && video.grab()) ++frames;
+        return frames;
+    }
+
+    /// Decode the video, starting at the given pair of frames, and analyse every pair of frames, storing
+    /// the differences in the cache while it has room for them.
+    ///
+    /// With a phaseMargin, the timing of the first detections is used to predict the next on-transitions. Once the
+    /// phase is locked, frames that cannot show a new LED are only grabbed, not decoded.
+    /// Returns the number of frames in the video.
+    unsigned int DecodeSequence( std::size_t first)
+    {
+        cv::VideoCapture video;
+        unsigned int frames = OpenVideo( video, first);
+
+        if (Read( video, m_previous)) ++frames;
+        m_frameSize = m_previous.size();
+
+        const double fps = video.get( cv::CAP_PROP_FPS);
+        m_fps = fps;
+        Detection::PhaseLock phase{ static_cast<double>( settings.phaseMargin), fps > 0 ? 1000.0 / fps : 0.0};
+        bool havePrevious = !m_previous.empty();
+        while (Grab( video))
+        {
+            ++frames;
+            const double time = phase.IsEnabled() ? video.get( cv::CAP_PROP_POS_MSEC) : 0.0;
+            if (phase.CanSkip( time))
+            {
+                havePrevious = false;
+                ++m_grabbedOnly;
+                m_profiler.Count( Detection::SkipCounter);
+                continue;
+            }
+            if (!havePrevious)
+            {
+                // the first frame after a series of skipped frames.
+                Retrieve( video, m_previous);
+                havePrevious = true;
+                continue;
+            }
+            Retrieve( video, m_current);
+
+            // frames are counted from zero, so this is the index of the previous frame.
+            const std::size_t pair = frames - 2;
+            bool found = false;
+            if (Memo( pair).IsValidFor( settings) && !m_cache.Wants( pair))
+            {
+                found = Accept( pair);
+                if (found && WantsPatch( pair))
+                {
+                    Timed timed{ m_profiler, Detection::BookkeepingStage};
+                    const cv::Rect rect = PatchRect( m_foundLeds.back());
+                    Detection::RedDifference( m_current( rect), m_previous( rect), m_skipped);
+                    RememberPatch( pair, m_skipped, rect.tl());
+                }
+            }
+            else
+            {
+                const cv::Rect area = AreaOf( pair, m_frameSize);
+                m_workspace.Prepare( area.size());
+                {
+                    Timed timed{ m_profiler, Detection::DifferenceStage};
+                    Detection::RedDifference( m_current( area), m_previous( area), m_workspace.red);
+                }
+                {
+                    Timed timed{ m_profiler, Detection::BookkeepingStage};
+                    m_cache.Add( pair, m_workspace.red);
+                }
+                found = Analyse( pair, m_workspace.red);
+            }
+
+            if (found)
+            {
+                phase.Detected( time);
+            }
+            else
+            {
+                phase.Missed( time);
+            }
+
+            if (found && phase.IsLocked())
+            {
+                // no need for the frame after the detection, the phase lock decides which frame is decoded next.
+                havePrevious = false;
+            }
+            else if (found)
+            {
+                // skip next frame if LED detected
+                if (Read( video, m_previous))
+                {
+                    ++frames;
+                    m_profiler.Count( Detection::SkipCounter);
+                    if (m_cache.Wants( pair + 1))
+                    {
+                        // the skipped difference is not analysed now, but may be with other settings.
+                        const cv::Rect area = AreaOf( pair + 1, m_frameSize);
+                        Detection::RedDifference( m_previous( area), m_current( area), m_skipped);
+                        m_cache.Add( pair + 1, m_skipped);
+                    }
+                }
+                else
+                {
+                    havePrevious = false;
+                }
+            }
+            else
+            {
+                // swap instead of move, so that the next read can re-use the buffer of the previous frame.
+                swap( m_previous, m_current);
+            }
+        }
+
+        m_pairCount = frames ? frames - 1 : 0;
+        return frames;
+    }
+
+    /// Video access with the time spent in the decoder attributed to the decode stage.
+    static bool Read( cv::VideoCapture &video, cv::Mat &frame, Detection::Profiler &profiler)
+    {
+        Timed timed{ profiler, Detection::DecodeStage};
+        return video.read( frame);
+    }
+
+    bool Read( cv::VideoCapture &video, cv::Mat &frame)
+    {
+        return Read( video, frame, m_profiler);
+    }
+
+    static bool Grab( cv::VideoCapture &video, Detection::Profiler &profiler)
+    {
+        Timed timed{ profiler, Detection::DecodeStage};
+        return video.grab();
+    }
+
+    bool Grab( cv::VideoCapture &video)
+    {
+        return Grab( video, m_profiler);
+    }
+
+    static bool Retrieve( cv::VideoCapture &video, cv::Mat &frame, Detection::Profiler &profiler)
+    {
+        Timed timed{ profiler, Detection::DecodeStage};
+        return video.retrieve( frame);
+    }
+
+    bool Retrieve( cv::VideoCapture &video, cv::Mat &frame)
+    {
+        return Retrieve( video, frame, m_profiler);
+    }
+
+    /// A pair of frames for the workers of DecodeParallel(). Both frames are empty if the decoder thread skipped
+    /// one of them.
+    struct FramePair
+    {
+        std::size_t pair;
+        cv::Mat previous;
+        cv::Mat current;
+        double time;        // time stamp of 'current' in ms, 0 without phase lock
+    };
+
+    struct PairResult
+    {
+        std::size_t pair;
+        cv::Mat red;
+        cv::Mat blurred;
+        cv::Rect area;
+        std::vector<Detection::BlobFinder::Candidate> candidates;
+        double time = 0.0;
+        bool skipped = false; // not decoded because of the phase lock
+    };
+
+    /// Pipelined version of DecodeSequence().
+    ///
+    /// A decoder thread feeds pairs of frames into a bounded queue, a pool of workers finds the blob candidates of
+    /// every pair and this thread merges the results in frame order. Because it is not known in advance which pairs
+    /// will be skipped after a detection, the workers analyse all pairs; the merge applies the same sequence logic as
+    /// DecodeSequence(), so the results are identical.
+    ///
+    /// With a phaseMargin, the merge feeds its detections to a phase lock that the decoder thread uses to only grab
+    /// the frames that cannot show a new LED, as DecodeSequence() does. The decoder thread runs ahead of the merge, so
+    /// it sees the lock a little late, which only means that it decodes some frames that could have been skipped.
+    unsigned int DecodeParallel( std::size_t pair)
+    {
+        cv::VideoCapture video;
+        unsigned int frames = OpenVideo( video, pair);
+        m_fps = video.get( cv::CAP_PROP_FPS);
+        Detection::PhaseLock phase{ static_cast<double>( settings.phaseMargin), m_fps > 0 ? 1000.0 / m_fps : 0.0};
+        std::mutex phaseMutex;
+        unsigned int grabbedOnly = 0;
+
+        const unsigned int workerCount = m_threads - 1;
+        const Settings current = settings;
+        const Detection::BlobFinder &detector = Detector();
+        const cv::Size blurSize{ 1 + 2 * current.blurValue, 1 + 2 * current.blurValue};
+        if (m_blurCacheValue != current.blurValue)
+        {
+            m_blurCache.Clear();
+            m_blurCacheValue = current.blurValue;
+        }
+
+        Detection::BoundedQueue<FramePair> framePairs{ 2 * workerCount};
+        Detection::BoundedQueue<PairResult> results{ 2 * workerCount};
+        std::atomic<unsigned int> activeWorkers{ workerCount};
+        std::mutex errorMutex;
+        std::exception_ptr error;
+        cv::Mat last;
+        std::vector<Detection::Profiler> profiles( workerCount + 1); // one per thread, merged after the join
+
+        auto fail = [&]( std::exception_ptr e) {
+            {
+                std::lock_guard<std::mutex> lock( errorMutex);
+                if (!error) error = e;
+            }
+            framePairs.Close();
+            results.Close();
+        };
+
+        std::vector<std::thread> threads;
+        threads.emplace_back( [&]() {
+            try
+            {
+                auto &profiler = profiles[0];
+                std::size_t index = pair;
+                cv::Mat previous;
+                if (Read( video, previous, profiler)) ++frames;
+                {
+                    std::lock_guard<std::mutex> lock( m_regionMutex);
+                    m_frameSize = previous.size();
+                }
+                cv::Mat next;
+                while (Grab( video, profiler))
+                {
+                    ++frames;
+                    const double time = phase.IsEnabled() ? video.get( cv::CAP_PROP_POS_MSEC) : 0.0;
+                    bool skip;
+                    {
+                        std::lock_guard<std::mutex> lock( phaseMutex);
+                        skip = phase.CanSkip( time);
+                    }
+
+                    if (skip)
+                    {
+                        ++grabbedOnly;
+                        profiler.Count( Detection::SkipCounter);
+                        previous.release();
+                    }
+                    else
+                    {
+                        Retrieve( video, next, profiler);
+                    }
+
+                    // a pair with a skipped frame is passed on without frames, so that the merge can follow it.
+                    const bool complete = !skip && !previous.empty();
+                    if (!framePairs.Push( complete ? FramePair{ index, previous, next, time} : FramePair{ index, cv::Mat(), cv::Mat(), time})) break;
+                    ++index;
+                    previous = next;
+                    next = cv::Mat(); // the workers still use the old buffer
+                }
+                last = previous;
+                framePairs.Close();
+            }
+            catch (...)
+            {
+                fail( std::current_exception());
+            }
+        });
+
+        for (unsigned int worker = 0; worker < workerCount; ++worker)
+        {
+            threads.emplace_back( [&, worker]() {
+                try
+                {
+                    auto &profiler = profiles[worker + 1];
+                    Detection::BlobFinder finder{ detector};
+                    Detection::PyramidFinder pyramid;
+                    cv::Mat mask;
+                    FramePair input;
+                    while (framePairs.Pop( input))
+                    {
+                        PairResult result;
+                        result.pair = input.pair;
+                        result.time = input.time;
+                        if (input.previous.empty())
+                        {
+                            result.skipped = true;
+                            if (!results.Push( std::move( result))) break;
+                            continue;
+                        }
+                        result.area = AreaOf( input.pair, input.current.size());
+                        {
+                            Timed timed{ profiler, Detection::DifferenceStage};
+                            Detection::RedDifference( input.current( result.area), input.previous( result.area), result.red);
+                        }
+                        if (current.pyramidLevels > 0)
+                        {
+                            Timed timed{ profiler, Detection::BlobStage};
+                            pyramid.FindCandidates( result.red, PyramidParams( current), finder, result.candidates);
+                        }
+                        else
+                        {
+                            {
+                                Timed timed{ profiler, Detection::BlurStage};
+                                cv::GaussianBlur( result.red, result.blurred, blurSize, 0);
+                            }
+                            {
+                                Timed timed{ profiler, Detection::ThresholdStage};
+                                cv::inRange( result.blurred,
+                                        cv::Scalar( current.lowerThreshold),
+                                        cv::Scalar( current.upperThreshold),
+                                        mask);
+                            }
+                            Timed timed{ profiler, Detection::BlobStage};
+                            finder.FindCandidates( mask, current.minArea, result.candidates);
+                        }
+                        Shift( result.candidates, result.area.tl());
+                        if (!results.Push( std::move( result))) break;
+                    }
+                }
+                catch (...)
+                {
+                    fail( std::current_exception());
+                }
+                if (--activeWorkers == 0) results.Close();
+            });
+        }
+
+        // merge in frame order. 'pair' is the next pair that the sequence logic needs, results of
+        // pairs that come before it were skipped and are only remembered.
+        std::map<std::size_t, PairResult> pending;
+        PairResult result;
+        try
+        {
+            while (results.Pop( result))
+            {
+                const std::size_t index = result.pair;
+                pending[index] = std::move( result);
+                while (!pending.empty() && pending.begin()->first <= pair)
+                {
+                    auto &first = pending.begin()->second;
+                    if (first.skipped)
+                    {
+                        // the decoder thread only grabbed a frame of this pair, see DecodeSequence().
+                        if (first.pair == pair) ++pair;
+                        pending.erase( pending.begin());
+                        continue;
+                    }
+                    bool reanalyse = false;
+
+                    {
+                        Timed timed{ m_profiler, Detection::BookkeepingStage};
+
+                        // a worker may have analysed the whole frame before the region was locked. Its candidates
+                        // can include blobs outside the region, so only the region of its difference is kept and
+                        // the pair is analysed again below, like DecodeSequence() would.
+                        const cv::Rect area = AreaOf( first.pair, m_frameSize);
+                        if (first.area != area)
+                        {
+                            first.red = first.red( area - first.area.tl());
+                            first.area = area;
+                            first.blurred.release();
+                            first.candidates.clear();
+                            Memo( first.pair) = CandidateMemo{};
+                            reanalyse = true;
+                        }
+
+                        m_cache.Add( first.pair, first.red);
+                        if (!reanalyse)
+                        {
+                            if (!first.blurred.empty()) m_blurCache.Add( first.pair, first.blurred);
+
+                            auto &memo = Memo( first.pair);
+                            memo.candidates.swap( first.candidates);
+                            memo.Remember( current);
+                        }
+                    }
+
+                    if (first.pair == pair)
+                    {
+                        bool found;
+                        if (reanalyse)
+                        {
+                            found = Analyse( pair, first.red);
+                        }
+                        else
+                        {
+                            found = Accept( pair);
+                            if (found)
+                            {
+                                Timed timed{ m_profiler, Detection::BookkeepingStage};
+                                RememberPatch( pair, first.red, first.area.tl());
+                            }
+                        }
+
+                        {
+                            std::lock_guard<std::mutex> lock( phaseMutex);
+                            if (found)
+                            {
+                                phase.Detected( first.time);
+                            }
+                            else
+                            {
+                                phase.Missed( first.time);
+                            }
+                        }
+                        pair += found ? 2 : 1;
+                    }
+                    else
+                    {
+                        // analysed by a worker, but skipped by the sequence logic.
+                        m_profiler.Count( Detection::SkipCounter);
+                    }
+                    pending.erase( pending.begin());
+                }
+            }
+        }
+        catch (...)
+        {
+            fail( std::current_exception());
+        }
+
+        for (auto &thread : threads)
+        {
+            thread.join();
+        }
+        for (const auto &profile : profiles)
+        {
+            m_profiler.Merge( profile);
+        }
+        m_grabbedOnly += grabbedOnly;
+        if (error)
+        {
+            std::rethrow_exception( error);
+        }
+
+        if (!last.empty())
+        {
+            m_previous = last;
+        }
+        m_pairCount = frames ? frames - 1 : 0;
+        return frames;
+    }
+
+    /**
+     * Buffers for the per-frame analysis in Update().
+     *
+     * All buffers are allocated when the first frame arrives and are re-used for every following frame of the same
+     * size. The allocations counter is increased whenever a buffer had to be (re-)allocated, so in a steady-state scan
+     * it should not change. The difference caches copy the images they keep into buffers of their own, which
+     * ScanSummary::cacheAllocations counts.
+     */
+    struct FrameWorkspace
+    {
+        cv::Mat red;        // saturated difference of the red channels of the current and previous frame
+        cv::Mat blurred;
+        cv::Mat mask;
+        KeyPoints features;
+        cv::Size size;
+        unsigned int allocations = 0;
+
+        void Prepare( const cv::Size &frameSize)
+        {
+            if (size != frameSize)
+            {
+                size = frameSize;
+                red.create( frameSize, CV_8UC1);
+                blurred.create( frameSize, CV_8UC1);
+                mask.create( frameSize, CV_8UC1);
+                features.reserve( 16);
+                ++allocations;
+                Remember();
+            }
+        }
+
+        /// Count an allocation if any of the OpenCV functions did not write into the prepared buffers.
+        void Verify()
+        {
+            if (   data[0] != red.data
+                || data[1] != blurred.data
+                || data[2] != mask.data)
+            {
+                ++allocations;
+                Remember();
+            }
+        }
+
+    private:
+        void Remember()
+        {
+            data[0] = red.data;
+            data[1] = blurred.data;
+            data[2] = mask.data;
+        }
+
+        const uchar *data[3] = {};
+    };
+
+    /// Return the blob detector, configured for the current settings. The detector is only re-configured when the
+    /// settings change.
+    Detection::BlobFinder &Detector()
+    {
+        if (!m_detectorConfigured || !(m_detectorSettings == settings))
+        {
+            m_detector.SetParams( BlobParams( settings));
+            m_detectorSettings = settings;
+            m_detectorConfigured = true;
+        }
+        return m_detector;
+    }
+
+    Settings settings;
+    std::vector<cv::KeyPoint> m_foundLeds;
+    std::vector<std::size_t> m_foundPairs;  // pair of frames of every found LED, NoPair if not known
+    std::map<std::size_t, Patch> m_patches; // red difference around the LED of a pair, for the sub-pixel fit
+    cv::Mat m_current;
+    cv::Mat m_previous;
+    std::string m_fileName;
+    bool m_interactive;
+    ScanSummary m_summary;
+    Detection::Profiler m_profiler;
+    FrameWorkspace m_workspace;
+    Detection::BlobFinder m_detector;
+    Settings m_detectorSettings;
+    bool m_detectorConfigured = false;
+    Detection::DifferenceCache m_cache;
+    Detection::DifferenceCache m_blurCache;
+    Detection::PyramidFinder m_pyramid;
+    int m_blurCacheValue = -1;
+    std::vector<CandidateMemo> m_memo;
+    std::size_t m_pairCount = 0;
+    unsigned int m_threads = 1;
+    cv::Size m_frameSize;
+    cv::Rect m_region;                      // area around the LEDs, empty if not known (yet)
+    std::size_t m_regionPair = 0;       // pair of frames in which all LEDs were lit
+    int m_regionMargin = 0;             // settings.cropMargin that m_region was built with
+    mutable std::mutex m_regionMutex;
+    cv::Mat m_skipped;
+    unsigned int m_grabbedOnly = 0;
+    Detection::ResultSink *m_sink = nullptr;
+    double m_fps = 0.0;                 // frame rate of the video, 0 if not known
+};
+
+inline void ShowTweaked( int, void *detector )
+{
+    reinterpret_cast<LedDetector*>( detector)->ScanSequence();
+}
+
+#endif //LED_DETECTOR_HPP_
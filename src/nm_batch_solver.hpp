@@ -0,0 +1,146 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( NM_BATCH_SOLVER_HPP_)
+#define NM_BATCH_SOLVER_HPP_
+#include <algorithm>
+#include <cstddef>
+#include <vector>
+
+#include "nm_simplex_solver.hpp"
+#include "work_stealing_pool.hpp"
+
+namespace Solvers
+{
+
+/// The points of a batch of problems in structure-of-arrays form: coordinate 'axis' of all problems is
+/// stored contiguously, so that Coordinate(axis) can be processed as one array.
+///
+/// This layout is only used for the starting points and results of a batch. The solvers do not run in lockstep:
+/// every problem runs its own simplex on one thread of the pool.
+template<int dimension>
+class BatchPoints
+{
+public:
+    typedef typename ArrayPoints<dimension>::Point Point;
+
+    explicit BatchPoints(std::size_t count = 0) :
+            count(count), values(dimension * count)
+    {
+    }
+
+    std::size_t size() const
+    {
+        return count;
+    }
+
+    void Set(std::size_t problem, const Point &p)
+    {
+        for (int axis = 0; axis < dimension; ++axis)
+        {
+            values[axis * count + problem] = p[axis];
+        }
+    }
+
+    Point Get(std::size_t problem) const
+    {
+        Point p;
+        for (int axis = 0; axis < dimension; ++axis)
+        {
+            p[axis] = values[axis * count + problem];
+        }
+        return p;
+    }
+
+    /// the values of one coordinate for all problems
+    const double *Coordinate(int axis) const
+    {
+        return values.data() + axis * count;
+    }
+
+    double *Coordinate(int axis)
+    {
+        return values.data() + axis * count;
+    }
+
+private:
+    std::size_t count;
+    std::vector<double> values;
+};
+
+/// The outcome of solving a batch of problems, per problem.
+template<int dimension>
+struct BatchResults
+{
+    explicit BatchResults(std::size_t count) :
+            positions(count), costs(count), iterations(count)
+    {
+    }
+
+    /// index of the problem with the lowest final cost
+    std::size_t Best() const
+    {
+        return std::min_element(costs.begin(), costs.end()) - costs.begin();
+    }
+
+    BatchPoints<dimension> positions;
+    std::vector<double> costs;
+    std::vector<unsigned int> iterations;
+};
+
+/// Solve many independent problems in parallel, one simplex per problem.
+///
+/// costFor(i) must return the cost function (any callable that takes an ArrayPoints<dimension>::Point) of problem i,
+/// starts.Get(i) is its starting point. Problems are distributed over the threads of the pool, idle threads
+/// steal problems from busy ones.
+/// 'steps' are the per-axis starting steps of all problems.
+template<int dimension, typename CostFor>
+BatchResults<dimension> SolveMany(WorkStealingPool &pool,
+        const BatchPoints<dimension> &starts, CostFor costFor,
+        const typename ArrayPoints<dimension>::Point &steps, double epsilon,
+        unsigned int maxIterations = 1000,
+        const Coefficients &coefficients = Coefficients::Standard())
+{
+    BatchResults<dimension> results(starts.size());
+    pool.ForEach(starts.size(), [&](std::size_t problem)
+    {
+        auto solver = MakeSolver<dimension>(costFor(problem), 1.0, epsilon);
+        solver.SetSteps(steps);
+        solver.SetCoefficients(coefficients);
+        results.positions.Set(problem, solver.FindMinimun(starts.Get(problem), maxIterations));
+        results.costs[problem] = solver.GetLastCostValue();
+        results.iterations[problem] = solver.GetLastIterationCount();
+    });
+    return results;
+}
+
+/// Solve many independent problems in parallel, with the same starting step for all axes.
+template<int dimension, typename CostFor>
+BatchResults<dimension> SolveMany(WorkStealingPool &pool,
+        const BatchPoints<dimension> &starts, CostFor costFor, double step,
+        double epsilon, unsigned int maxIterations = 1000,
+        const Coefficients &coefficients = Coefficients::Standard())
+{
+    typename ArrayPoints<dimension>::Point steps;
+    steps.fill(step);
+    return SolveMany(pool, starts, costFor, steps, epsilon, maxIterations, coefficients);
+}
+
+/// Minimize one cost function from several starting points in parallel, e.g. to avoid local minima.
+/// Use Best() on the result to find the lowest minimum.
+template<int dimension, typename CostFunction>
+BatchResults<dimension> SolveMultiStart(WorkStealingPool &pool,
+        const BatchPoints<dimension> &starts, const CostFunction &f,
+        double step, double epsilon, unsigned int maxIterations = 1000,
+        const Coefficients &coefficients = Coefficients::Standard())
+{
+    return SolveMany(pool, starts, [&f](std::size_t)
+    {   return f;}, step, epsilon, maxIterations, coefficients);
+}
+}
+#endif //NM_BATCH_SOLVER_HPP_
@@ -8,12 +8,20 @@
 
 #if !defined( NM_SIMPLEX_SOLVER_HPP_)
 #define NM_SIMPLEX_SOLVER_HPP_
+#include <algorithm>
+#include <iostream>
 #include <utility> // for std::pair
+#include <array>
+#include <chrono>
+#include <vector>
 #include <functional>
 #include <boost/numeric/ublas/vector.hpp>
 #include <boost/numeric/ublas/vector_expression.hpp>
+#include <boost/numeric/ublas/io.hpp>
 #include <boost/array.hpp>
 
+#include "work_stealing_pool.hpp"
+
 namespace Solvers
 {
 static const double alpha = 1;
@@ -21,15 +29,221 @@ static const double beta = 0.5;
 static const double gamma = 2;
 static const double delta = 0.5;
 
+/// The coefficients of the Nelder-Mead steps.
+struct Coefficients
+{
+    double alpha; ///< reflection
+    double beta;  ///< contraction
+    double gamma; ///< expansion
+    double delta; ///< shrink
+
+    /// the classic coefficients, the namespace constants above.
+    static Coefficients Standard()
+    {
+        return Coefficients
+        { Solvers::alpha, Solvers::beta, Solvers::gamma, Solvers::delta };
+    }
+
+    /// The dimension-dependent coefficients of Gao and Han ("Implementing the Nelder-Mead simplex algorithm
+    /// with adaptive parameters", 2012). They are the standard ones for dimension 2 and keep the simplex from
+    /// degenerating in higher dimensions.
+    static Coefficients Adaptive(int dimension)
+    {
+        const double n = dimension;
+        return Coefficients
+        { 1.0, 0.75 - 1 / (2 * n), 1 + 2 / n, 1 - 1 / n };
+    }
+};
+
+/// Point arithmetic for the solver on boost ublas vectors.
+template<int dimension>
+struct UblasPoints
+{
+    typedef boost::numeric::ublas::c_vector<double, dimension> Point;
+
+    static Point Zero()
+    {
+        return boost::numeric::ublas::zero_vector<double>(dimension);
+    }
+
+    /// from + factor * (towards - from)
+    static Point Move(const Point &from, const Point &towards, double factor)
+    {
+        return from + factor * (towards - from);
+    }
+
+    /// the average of the points in [begin, begin + dimension)
+    template<typename Iterator>
+    static Point Centroid(Iterator begin)
+    {
+        Point centroid = Zero();
+        for (int i = 0; i < dimension; ++i, ++begin)
+        {
+            centroid += begin->position;
+        }
+        centroid /= dimension;
+        return centroid;
+    }
+
+    /// point + step * (unit vector along axis)
+    static Point Offset(const Point &point, int axis, double step)
+    {
+        return point
+                + step * boost::numeric::ublas::unit_vector<double>(dimension, axis);
+    }
+
+    static void Print(std::ostream &output, const Point &p)
+    {
+        output << p;
+    }
+};
+
+/// Point arithmetic for the solver on std::array, without any temporaries or heap allocations.
+/// All element-wise loops have a compile-time trip count, so that the compiler unrolls them.
+template<int dimension>
+struct ArrayPoints
+{
+    typedef std::array<double, dimension> Point;
+
+    static Point Zero()
+    {
+        Point result;
+        result.fill(0.0);
+        return result;
+    }
+
+    static Point Move(const Point &from, const Point &towards, double factor)
+    {
+        Point result;
+        Unrolled<0>::Move(result, from, towards, factor);
+        return result;
+    }
+
+    template<typename Iterator>
+    static Point Centroid(Iterator begin)
+    {
+        Point centroid = begin->position;
+        for (int i = 1; i < dimension; ++i)
+        {
+            Unrolled<0>::Add(centroid, (++begin)->position);
+        }
+        Unrolled<0>::Scale(centroid, 1.0 / dimension);
+        return centroid;
+    }
+
+    static Point Offset(const Point &point, int axis, double step)
+    {
+        Point result = point;
+        result[axis] += step;
+        return result;
+    }
+
+    static void Print(std::ostream &output, const Point &p)
+    {
+        output << '[' << dimension << "](";
+        for (int i = 0; i < dimension; ++i)
+        {
+            output << (i ? "," : "") << p[i];
+        }
+        output << ')';
+    }
+
+private:
+    template<int index, bool done = index == dimension>
+    struct Unrolled
+    {
+        static void Move(Point &result, const Point &from, const Point &towards,
+                double factor)
+        {
+            result[index] = from[index] + factor * (towards[index] - from[index]);
+            Unrolled<index + 1>::Move(result, from, towards, factor);
+        }
+
+        static void Add(Point &sum, const Point &p)
+        {
+            sum[index] += p[index];
+            Unrolled<index + 1>::Add(sum, p);
+        }
+
+        static void Scale(Point &p, double factor)
+        {
+            p[index] *= factor;
+            Unrolled<index + 1>::Scale(p, factor);
+        }
+    };
+
+    template<int index>
+    struct Unrolled<index, true>
+    {
+        static void Move(Point &, const Point &, const Point &, double)
+        {
+        }
+        static void Add(Point &, const Point &)
+        {
+        }
+        static void Scale(Point &, double)
+        {
+        }
+    };
+};
+
+/// the kinds of steps that the solver takes. Start is the evaluation of the starting simplex.
+enum StepType
+{
+    Start, Reflect, Expand, Contract, InnerContract, Shrink, StepTypeCount
+};
+
+/// Counters and timings of the last call to NmSimplexSolver::FindMinimun()
+struct SolverStats
+{
+    unsigned int iterations = 0;
+    unsigned int evaluations[StepTypeCount] = { };   ///< cost function evaluations per step type
+    unsigned int steps[StepTypeCount] = { };         ///< number of iterations that ended with each step type
+
+    /// only measured if timing is enabled.
+    double costSeconds = 0.0;  ///< time spent inside the cost function
+    double totalSeconds = 0.0; ///< time spent in FindMinimun(), including the cost function
+
+    unsigned int TotalEvaluations() const
+    {
+        unsigned int total = 0;
+        for (auto count : evaluations)
+        {
+            total += count;
+        }
+        return total;
+    }
+
+    double OverheadSeconds() const
+    {
+        return totalSeconds - costSeconds;
+    }
+};
+
+/// one iteration of the solver, as recorded in the trace.
+struct TraceEntry
+{
+    unsigned int iteration;
+    StepType step;
+    double best;    ///< lowest value in the simplex after the step
+    double spread;  ///< difference between the highest and lowest value after the step
+};
+
 /// implementation of the Nelder-Mead simplex solver
+///
+/// CostFunction can be any callable that takes a Point and returns a double. The default, std::function, accepts
+/// anything but costs an indirect call per evaluation; use MakeSolver() to get a solver for the exact type of a
+/// lambda or function object. Points selects the point type and its arithmetic: UblasPoints (the default) or
+/// ArrayPoints.
 template<int dimension, typename CostFunction = std::function<
-        double(const boost::numeric::ublas::c_vector<double, dimension> &)> >
+        double(const boost::numeric::ublas::c_vector<double, dimension> &)>,
+        typename Points = UblasPoints<dimension> >
 class NmSimplexSolver
 {
 public:
 
     /// a point in n-dimensional space
-    typedef boost::numeric::ublas::c_vector<double, dimension> Point;
+    typedef typename Points::Point Point;
 
     /// a combination of a point in n-dimensional space and the corresponding value f(p)
     struct SimplexPoint
@@ -47,7 +261,9 @@ public:
         friend std::ostream &operator<<(std::ostream &output,
                 const SimplexPoint &p)
         {
-            output << '[' << p.value << ',' << p.position << "]";
+            output << '[' << p.value << ',';
+            Points::Print(output, p.position);
+            output << "]";
             return output;
         }
 
@@ -57,7 +273,7 @@ public:
         }
 
         SimplexPoint() :
-                position(0 * Point()), value(0.0)
+                position(Points::Zero()), value(0.0)
         {
         }
         ;
@@ -72,13 +288,65 @@ public:
 
     NmSimplexSolver(CostFunction f, double step, double epsilon, bool doReport =
             false) :
-            f(f), step(step), epsilon(epsilon), lastIterationCount(0), lastCostValue(
-                    0.0), doReport(doReport)
+            f(f), epsilon(epsilon), lastIterationCount(0), lastCostValue(
+                    0.0), epsilons(boost::numeric::ublas::zero_vector<double>(2)), doReport(
+                    doReport), coefficients(Coefficients::Standard())
+    {
+        steps.fill(step);
+    }
+
+    /// Use other coefficients than the standard ones, e.g. Coefficients::Adaptive(dimension).
+    void SetCoefficients(const Coefficients &newCoefficients)
     {
+        coefficients = newCoefficients;
+    }
+
+    const Coefficients &GetCoefficients() const
+    {
+        return coefficients;
+    }
+
+    /// Use a different starting step for every axis, instead of the single step of the constructor.
+    /// This is useful if the parameters have different scales, e.g. a position in pixels and an amplitude.
+    void SetSteps(const std::array<double, dimension> &newSteps)
+    {
+        steps = newSteps;
+    }
+
+    /// Measure the time spent inside and outside the cost function in the stats.
+    /// This costs two clock readings per evaluation, so it is off by default.
+    void EnableTiming(bool enable = true)
+    {
+        timing = enable;
+    }
+
+    /// Evaluate the reflected, expanded and both contracted points of every iteration at once on the threads of
+    /// the pool, and the points of a shrink step as well. This pays off if the cost function is expensive, because
+    /// the time per iteration then becomes that of a single evaluation. The cost function must be safe to call from
+    /// several threads at once. The pool must not be one that is running this solver (e.g. in SolveMany()).
+    /// A null pool, the default, switches back to evaluating one point at a time. On a single core the speculative
+    /// evaluations are pure overhead, so only set a pool when several cores are available.
+    void SetPool(WorkStealingPool *newPool)
+    {
+        pool = newPool;
+    }
+
+    /// Keep the last 'capacity' iterations of every FindMinimun() call in a trace, 0 disables the trace.
+    /// The memory for the trace is allocated here, not while solving.
+    void SetTraceCapacity(std::size_t capacity)
+    {
+        trace.assign(capacity, TraceEntry());
+        traceCount = 0;
     }
 
     Point FindMinimun(Point startingPoint, unsigned int maxIterations = 1000)
     {
+        stats = SolverStats();
+        traceCount = 0;
+        const auto startTime =
+                timing ? std::chrono::steady_clock::now() :
+                        std::chrono::steady_clock::time_point();
+
         Simplex simplex = StartingSimplex(startingPoint);
 
         // indices to points and values. These indices have meaning and can be constant
@@ -93,43 +361,48 @@ public:
             // find the centroid of all but the worst points in the simplex and reflect the worst
             // point in that centroid.
             Point centroid = FindCentroid(simplex);
-            SimplexPoint reflected = PointAndValue(
-                    centroid + alpha * (centroid - simplex[worst].position));
+            if (pool)
+            {
+                Speculate(centroid, simplex[worst].position);
+            }
+            SimplexPoint reflected = Evaluate(
+                    Points::Move(centroid, simplex[worst].position, -coefficients.alpha),
+                    Reflect);
 
             bool doReplace = true; // true-> replace worst point, false -> shrink simplex
             SimplexPoint replacement;
+            StepType taken = Reflect;
 
             if (simplex[best] <= reflected && reflected < simplex[secondWorst])
             {
                 replacement = reflected;
-                Report('r', simplex); // reflect
             }
             else if (reflected < simplex[best])
             {
-                SimplexPoint expanded = PointAndValue(
-                        centroid
-                                + gamma * (centroid - simplex[worst].position));
+                SimplexPoint expanded = Evaluate(
+                        Points::Move(centroid, simplex[worst].position, -coefficients.gamma),
+                        Expand);
                 if (expanded < reflected)
                 {
                     replacement = expanded;
-                    Report('e', simplex); // expand
+                    taken = Expand;
                 }
                 else
                 {
                     replacement = reflected;
-                    Report('r', simplex);
                 }
             }
             else // reflected >= simplex[secondWorst]
             {
                 if (reflected < simplex[worst])
                 {
-                    SimplexPoint contracted = PointAndValue(
-                            centroid + beta * (reflected.position - centroid));
+                    SimplexPoint contracted = Evaluate(
+                            Points::Move(centroid, reflected.position, coefficients.beta),
+                            Contract);
                     if (contracted <= simplex[worst])
                     {
                         replacement = contracted;
-                        Report('c', simplex); // contract (outer)
+                        taken = Contract; // contract (outer)
                     }
                     else
                     {
@@ -138,16 +411,14 @@ public:
                 }
                 else
                 {
-                    SimplexPoint contracted = PointAndValue(
-                            centroid
-                                    + beta
-                                            * (simplex[worst].position
-                                                    - centroid));
+                    SimplexPoint contracted = Evaluate(
+                            Points::Move(centroid, simplex[worst].position, coefficients.beta),
+                            InnerContract);
                     // notice the '<' instead of '<='
                     if (contracted < simplex[worst])
                     {
                         replacement = contracted;
-                        Report('i', simplex); // 'inner' contract
+                        taken = InnerContract; // 'inner' contract
                     }
                     else
                     {
@@ -166,16 +437,23 @@ public:
             else
             {
                 // as delta < 1 the grow function will actually shrink the simplex
-                Report('s', simplex); // 'shrink'
-                Grow(simplex, delta);
+                taken = Shrink;
+                Grow(simplex, coefficients.delta);
                 Sort(simplex);
             }
+            Report(iterationCount, taken, simplex);
 
         } while (++iterationCount <= maxIterations
                 && (simplex[worst].value - simplex[best].value > epsilon));
 
         lastIterationCount = iterationCount - 1;
         lastCostValue = simplex[best].value;
+        stats.iterations = lastIterationCount;
+        if (timing)
+        {
+            stats.totalSeconds = std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - startTime).count();
+        }
         return simplex[best].position;
 
     }
@@ -190,53 +468,152 @@ public:
         return lastCostValue;
     }
 
-    /// for debugging purposes, return the epsilon values for the last 2 iterations
+    /// for debugging purposes, return the epsilon values (difference between the highest and
+    /// lowest value in the simplex) of the last 2 iterations, the last one in element 1.
     const boost::numeric::ublas::c_vector<double, 2> GetEpsilons() const
     {
         return epsilons;
     }
 
+    /// counters and timings of the last call to FindMinimun()
+    const SolverStats &GetStats() const
+    {
+        return stats;
+    }
+
+    /// The trace of the last call to FindMinimun(), oldest iteration first.
+    /// If there were more iterations than the trace capacity, only the last ones are returned.
+    std::vector<TraceEntry> GetTrace() const
+    {
+        std::vector<TraceEntry> result;
+        const std::size_t capacity = trace.size();
+        const std::size_t count = std::min(traceCount, capacity);
+        result.reserve(count);
+        for (std::size_t i = traceCount - count; i < traceCount; ++i)
+        {
+            result.push_back(trace[i % capacity]);
+        }
+        return result;
+    }
+
+    /// one-letter name of a step type, as used by the debug output:
+    /// 'r'eflect, 'e'xpand, 'c'ontract, 'i'nner contract, 's'hrink.
+    static char Symbol(StepType step)
+    {
+        return "-recis"[step];
+    }
+
 private:
-    /// for debugging purposes, report on the specific iteratrion step that was taken.
-    /// the step should be 'r'eflect, 'e'xpand, 'c'ontract, 'i'nner contract, 's'hrink.
-    void Report(char what, const Simplex &simplex)
+    /// keep track of the specific iteration step that was taken.
+    void Report(unsigned int iteration, StepType step, const Simplex &simplex)
     {
+        ++stats.steps[step];
+        const double spread = simplex.back().value - simplex.front().value;
+        epsilons[0] = epsilons[1];
+        epsilons[1] = spread;
+
+        if (!trace.empty())
+        {
+            trace[traceCount++ % trace.size()] = TraceEntry
+            { iteration, step, simplex.front().value, spread };
+        }
+
         if (doReport)
         {
-            std::cout << what << '\t'
-                    << simplex.back().value - simplex.front().value << '\t'
+            std::cout << Symbol(step) << '\t' << spread << '\t'
                     << simplex.front().value << '\n';
         }
     }
 
     /// given a point position, return a simplexPoint that stores this position and the
     /// corresponding value
-    SimplexPoint PointAndValue(const Point &p) const
+    SimplexPoint PointAndValue(const Point &p, StepType step)
     {
-        return SimplexPoint(p, f(p));
+        ++stats.evaluations[step];
+        if (!timing)
+        {
+            return SimplexPoint(p, f(p));
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const double value = f(p);
+        stats.costSeconds += std::chrono::duration<double>(
+                std::chrono::steady_clock::now() - start).count();
+        return SimplexPoint(p, value);
     }
 
-    /// find the gravitational center of all but the last point in the simplex.
-    static Point FindCentroid(const Simplex &sortedSimplex)
+    /// The candidate point of the given step type, from the speculative evaluation if there is a pool.
+    SimplexPoint Evaluate(const Point &p, StepType step)
+    {
+        return pool ? speculated[step] : PointAndValue(p, step);
+    }
+
+    /// Evaluate all candidate points of an iteration in parallel. This uses the same formulas as FindMinimun().
+    void Speculate(const Point &centroid, const Point &worstPosition)
+    {
+        speculated[Reflect].position = Points::Move(centroid, worstPosition,
+                -coefficients.alpha);
+        speculated[Expand].position = Points::Move(centroid, worstPosition,
+                -coefficients.gamma);
+        speculated[Contract].position = Points::Move(centroid,
+                speculated[Reflect].position, coefficients.beta);
+        speculated[InnerContract].position = Points::Move(centroid,
+                worstPosition, coefficients.beta);
+
+        EvaluateInParallel(speculated + Reflect, speculated + Shrink, Reflect);
+    }
+
+    /// Evaluate the points in [begin, end) on the pool. Evaluations are counted as the
+    /// given step type and following ones if 'first' is not Shrink, or all as Shrink otherwise.
+    template<typename Iterator>
+    void EvaluateInParallel(Iterator begin, Iterator end, StepType first)
     {
-        Point centroid = boost::numeric::ublas::zero_vector<double>(dimension);
-        for (auto i = sortedSimplex.begin(); i + 1 < sortedSimplex.end(); ++i)
+        const auto start =
+                timing ? std::chrono::steady_clock::now() :
+                        std::chrono::steady_clock::time_point();
+
+        const CostFunction &cost = f;
+        pool->ForEach(end - begin, [&cost, begin](std::size_t index)
+        {
+            SimplexPoint &p = begin[index];
+            p.value = cost(p.position);
+        });
+
+        for (std::size_t index = 0; index < std::size_t(end - begin); ++index)
         {
-            centroid += i->position;
+            ++stats.evaluations[first == Shrink ? std::size_t(Shrink) : first + index];
         }
-        centroid /= dimension;
+        if (timing)
+        {
+            stats.costSeconds += std::chrono::duration<double>(
+                    std::chrono::steady_clock::now() - start).count();
+        }
+    }
 
-        return centroid;
+    /// find the gravitational center of all but the last point in the simplex.
+    static Point FindCentroid(const Simplex &sortedSimplex)
+    {
+        return Points::Centroid(sortedSimplex.begin());
     }
 
     /// Grow (factor > 1)  or shrink (factor < 1) all points in a simplex towards the first point.
-    void Grow(Simplex &simplex, double factor) const
+    void Grow(Simplex &simplex, double factor)
     {
         Point firstPoint = simplex[0].position;
+        if (pool)
+        {
+            for (auto i = simplex.begin() + 1; i < simplex.end(); ++i)
+            {
+                i->position = Points::Move(firstPoint, i->position, factor);
+            }
+            EvaluateInParallel(simplex.begin() + 1, simplex.end(), Shrink);
+            return;
+        }
+
         for (auto i = simplex.begin() + 1; i < simplex.end(); ++i)
         {
-            *i = PointAndValue(
-                    firstPoint + factor * (i->position - firstPoint));
+            *i = PointAndValue(Points::Move(firstPoint, i->position, factor),
+                    Shrink);
         }
     }
 
@@ -247,19 +624,16 @@ private:
     }
 
     /// Create a sorted starting simplex given a starting point.
-    /// The starting simplex consists of the starting point and all points at right angles, at distance 'step'
-    Simplex StartingSimplex(const Point &startingPoint) const
+    /// The starting simplex consists of the starting point and all points at right angles, at distance steps[axis]
+    Simplex StartingSimplex(const Point &startingPoint)
     {
-        using boost::numeric::ublas::unit_vector;
-
         Simplex simplex;
 
-        simplex[0] = PointAndValue(startingPoint);
+        simplex[0] = PointAndValue(startingPoint, Start);
         for (unsigned int i = 1; i < simplex.size(); ++i)
         {
             simplex[i] = PointAndValue(
-                    startingPoint
-                            + step * unit_vector<double>(dimension, i - 1));
+                    Points::Offset(startingPoint, i - 1, steps[i - 1]), Start);
         }
 
         Sort(simplex);
@@ -267,12 +641,29 @@ private:
     }
 
     CostFunction f;
-    const double step;
+    std::array<double, dimension> steps;
     const double epsilon;
     unsigned int lastIterationCount;
     double lastCostValue;
     boost::numeric::ublas::c_vector<double, 2> epsilons;
     bool doReport;
+    bool timing = false;
+    SolverStats stats;
+    std::vector<TraceEntry> trace; ///< ring buffer
+    std::size_t traceCount = 0;    ///< number of entries written to the trace by the last FindMinimun()
+    WorkStealingPool *pool = nullptr;
+    Coefficients coefficients;
+    SimplexPoint speculated[StepTypeCount]; ///< candidate points of the current iteration, if there is a pool
 };
+
+/// Create a solver on std::array points for the exact type of the given callable, so that
+/// the cost function can be inlined into the solver.
+template<int dimension, typename CostFunction>
+NmSimplexSolver<dimension, CostFunction, ArrayPoints<dimension> > MakeSolver(
+        CostFunction f, double step, double epsilon, bool doReport = false)
+{
+    return NmSimplexSolver<dimension, CostFunction, ArrayPoints<dimension> >(f,
+            step, epsilon, doReport);
+}
 }
 #endif //NM_SIMPLEX_SOLVER_HPP_
@@ -0,0 +1,122 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( PHASE_LOCK_HPP_)
+#define PHASE_LOCK_HPP_
+#include <cmath>
+#include <cstddef>
+#include <deque>
+
+namespace Detection
+{
+
+/// Track the timing of a registration sequence that switches LEDs on at a fixed rate.
+///
+/// The AVR registration sequences run on a fixed schedule (e.g. an LED every 200ms in simple_registration()). Once a
+/// few detections have arrived at a constant interval, the time of the next on-transition is known and the frames
+/// before it do not need to be decoded at all. All times are in milliseconds, as reported by CAP_PROP_POS_MSEC.
+class PhaseLock
+{
+public:
+    /// margin:         how far (in ms) a detection may be off from the expected time.
+    /// frameInterval:  time between two video frames in ms.
+    /// A margin or frame interval of zero disables the lock.
+    PhaseLock( double margin, double frameInterval, std::size_t lockCount = 3)
+    : m_margin( margin), m_frameInterval( frameInterval), m_lockCount( lockCount)
+    {
+    }
+
+    bool IsEnabled() const
+    {
+        return m_margin > 0 && m_frameInterval > 0;
+    }
+
+    bool IsLocked() const
+    {
+        return m_locked;
+    }
+
+    void Reset()
+    {
+        m_locked = false;
+        m_times.clear();
+    }
+
+    /// Register that an LED switched on in the frame with the given time stamp.
+    void Detected( double time)
+    {
+        if (!IsEnabled()) return;
+
+        if (m_locked)
+        {
+            const double interval = time - m_times.back();
+            if (std::abs( interval - m_period) > m_margin)
+            {
+                Reset();
+            }
+            else
+            {
+                // follow slow drift between the AVR clock and the camera clock.
+                m_period += (interval - m_period) / 4;
+                m_times.back() = time;
+                return;
+            }
+        }
+
+        m_times.push_back( time);
+        if (m_times.size() > m_lockCount + 1) m_times.pop_front();
+        if (m_times.size() == m_lockCount + 1)
+        {
+            // lock if all recent intervals are the same, within the margin.
+            const double period = (m_times.back() - m_times.front()) / m_lockCount;
+            m_locked = period > 2 * m_frameInterval;
+            for (std::size_t i = 1; i < m_times.size(); ++i)
+            {
+                m_locked = m_locked && std::abs( m_times[i] - m_times[i - 1] - period) <= m_margin;
+            }
+            if (m_locked)
+            {
+                m_period = period;
+                m_times.erase( m_times.begin(), m_times.end() - 1);
+            }
+        }
+    }
+
+    /// Report a frame in which no LED switched on. If the expected on-transition has passed, the lock is lost and
+    /// every frame needs to be analysed again.
+    void Missed( double time)
+    {
+        if (m_locked && time > Expected() + m_margin)
+        {
+            Reset();
+        }
+    }
+
+    /// True if neither the frame at the given time nor the frame after it can show a new LED, so that the frame
+    /// needs no decoding.
+    bool CanSkip( double time) const
+    {
+        return m_locked && time + m_frameInterval < Expected() - m_margin;
+    }
+
+private:
+    double Expected() const
+    {
+        return m_times.back() + m_period;
+    }
+
+    const double        m_margin;
+    const double        m_frameInterval;
+    const std::size_t   m_lockCount;
+    bool                m_locked = false;
+    double              m_period = 0.0;
+    std::deque<double>  m_times;    ///< times of the most recent detections
+};
+
+}
+#endif //PHASE_LOCK_HPP_
@@ -0,0 +1,114 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( PYRAMID_FINDER_HPP_)
+#define PYRAMID_FINDER_HPP_
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "blob_finder.hpp"
+
+namespace Detection
+{
+
+/// Coarse-to-fine blob candidate search.
+///
+/// Blurring and labeling a full-resolution frame is far more work than is needed to find out roughly where a
+/// lit LED is. This class first looks for candidates in a 2^levels times downsampled image and then runs the
+/// full-resolution blur, threshold and measurement only in a small window around each coarse candidate.
+class PyramidFinder
+{
+public:
+    struct Params
+    {
+        int    levels;          ///< number of pyrDown() steps (at most 4), each halves the resolution
+        int    blurValue;       ///< full-resolution blur, kernel size is 1 + 2 * blurValue
+        int    lowerThreshold;
+        int    upperThreshold;
+        double minArea;         ///< full-resolution minimum area in pixels
+        double tolerance;       ///< maximum distance in pixels between coarse and refined position
+    };
+
+    /// Find the candidates in a single-channel difference image and return them in full-resolution
+    /// coordinates, just like BlobFinder::FindCandidates() would on the blurred and thresholded image.
+    void FindCandidates( const cv::Mat &red, const Params &params, BlobFinder &finder,
+            std::vector<BlobFinder::Candidate> &candidates)
+    {
+        candidates.clear();
+
+        const int levels = std::min( std::max( params.levels, 0), 4);
+        m_pyramid.resize( levels);
+        const cv::Mat *coarse = &red;
+        for (int level = 0; level < levels; ++level)
+        {
+            cv::pyrDown( *coarse, m_pyramid[level]);
+            coarse = &m_pyramid[level];
+        }
+
+        const int scale = 1 << levels;
+        const int coarseBlur = std::max( 1, params.blurValue / scale);
+        cv::GaussianBlur( *coarse, m_blurred, cv::Size{ 1 + 2 * coarseBlur, 1 + 2 * coarseBlur}, 0);
+        cv::inRange( m_blurred, cv::Scalar( params.lowerThreshold), cv::Scalar( params.upperThreshold), m_mask);
+        finder.FindCandidates( m_mask, params.minArea / (scale * scale), m_coarse);
+
+        const cv::Rect frame{ 0, 0, red.cols, red.rows};
+        const cv::Size blurSize{ 1 + 2 * params.blurValue, 1 + 2 * params.blurValue};
+        for (const auto &coarseCandidate : m_coarse)
+        {
+            if (coarseCandidate.area == 0.0) continue;
+
+            // the window must hold the whole blob, plus enough room that the blur at the window edges
+            // does not change it.
+            const cv::Point2d center = coarseCandidate.location * static_cast<double>( scale);
+            const int halfSize = cvCeil( (coarseCandidate.radius + 2) * scale + params.blurValue + params.tolerance);
+            const cv::Rect window = frame & cv::Rect{
+                    cvFloor( center.x) - halfSize, cvFloor( center.y) - halfSize,
+                    2 * halfSize + 1, 2 * halfSize + 1};
+            if (window.empty()) continue;
+
+            cv::GaussianBlur( red( window), m_windowBlurred, blurSize, 0);
+            cv::inRange( m_windowBlurred, cv::Scalar( params.lowerThreshold), cv::Scalar( params.upperThreshold), m_windowMask);
+            finder.FindCandidates( m_windowMask, params.minArea, m_refined);
+
+            for (auto refined : m_refined)
+            {
+                refined.location.x += window.x;
+                refined.location.y += window.y;
+                if (cv::norm( refined.location - center) <= params.tolerance && !Contains( candidates, refined))
+                {
+                    candidates.push_back( refined);
+                }
+            }
+        }
+    }
+
+private:
+    /// Windows of nearby coarse candidates can overlap, so the same blob can be found twice.
+    static bool Contains( const std::vector<BlobFinder::Candidate> &candidates, const BlobFinder::Candidate &candidate)
+    {
+        for (const auto &existing : candidates)
+        {
+            if (cv::norm( existing.location - candidate.location) < 0.5) return true;
+        }
+        return false;
+    }
+
+    std::vector<cv::Mat> m_pyramid;
+    cv::Mat m_blurred;
+    cv::Mat m_mask;
+    cv::Mat m_windowBlurred;
+    cv::Mat m_windowMask;
+    std::vector<BlobFinder::Candidate> m_coarse;
+    std::vector<BlobFinder::Candidate> m_refined;
+};
+
+}
+#endif //PYRAMID_FINDER_HPP_
@@ -0,0 +1,70 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( RED_DIFFERENCE_HPP_)
+#define RED_DIFFERENCE_HPP_
+#include <opencv2/core/core.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace Detection
+{
+
+/// Compute the saturated difference (current - previous) of one channel (0: blue, 1: green, 2: red) of two
+/// BGR images.
+///
+/// This does in one pass what would otherwise take a 3-channel subtraction followed by a split(): the
+/// interleaved BGR pixels are read once and only the single-channel difference is written.
+/// The inner loop uses OpenCV universal intrinsics, so it vectorises for whatever SIMD instruction set
+/// (SSE, AVX2, NEON) the code is compiled for.
+inline void ChannelDifference( const cv::Mat &current, const cv::Mat &previous, int channel, cv::Mat &output)
+{
+    CV_Assert( current.type() == CV_8UC3 && previous.type() == CV_8UC3 && current.size() == previous.size());
+    CV_Assert( channel >= 0 && channel < 3);
+    output.create( current.size(), CV_8UC1);
+
+    // treat continuous images as one long row.
+    cv::Size size = current.size();
+    if (current.isContinuous() && previous.isContinuous() && output.isContinuous())
+    {
+        size.width *= size.height;
+        size.height = 1;
+    }
+
+    for (int row = 0; row < size.height; ++row)
+    {
+        const uchar *currentPixel = current.ptr<uchar>( row);
+        const uchar *previousPixel = previous.ptr<uchar>( row);
+        uchar *difference = output.ptr<uchar>( row);
+
+        int x = 0;
+#if CV_SIMD
+        const int lanes = CV_SIMD_WIDTH;
+        for (; x <= size.width - lanes; x += lanes)
+        {
+            cv::v_uint8 currentPlanes[3], previousPlanes[3];
+            cv::v_load_deinterleave( currentPixel + 3 * x, currentPlanes[0], currentPlanes[1], currentPlanes[2]);
+            cv::v_load_deinterleave( previousPixel + 3 * x, previousPlanes[0], previousPlanes[1], previousPlanes[2]);
+            cv::v_store( difference + x, currentPlanes[channel] - previousPlanes[channel]); // saturating for 8-bit lanes
+        }
+#endif
+        for (; x < size.width; ++x)
+        {
+            const int value = currentPixel[3 * x + channel] - previousPixel[3 * x + channel];
+            difference[x] = static_cast<uchar>( value > 0 ? value : 0);
+        }
+    }
+}
+
+/// Compute the saturated difference (current - previous) of only the red channel of two BGR images.
+inline void RedDifference( const cv::Mat &current, const cv::Mat &previous, cv::Mat &red)
+{
+    ChannelDifference( current, previous, 2, red);
+}
+
+}
+#endif //RED_DIFFERENCE_HPP_
@@ -0,0 +1,147 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( RESULT_SINK_HPP_)
+#define RESULT_SINK_HPP_
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <opencv2/core/core.hpp>
+
+namespace Detection
+{
+
+/// One LED, as soon as the detector accepts it.
+struct LedRecord
+{
+    std::size_t index;      ///< index of the LED in the string
+    long        frame;      ///< frame of the video in which the LED was lit, -1 if not known
+    double      time;       ///< time of that frame in ms from the start of the video, -1 if not known
+    cv::Point2f position;   ///< raw blob position in frame coordinates, before any sub-pixel refinement
+    float       confidence; ///< 0..1, the circularity of the blob
+};
+
+/// Receives the results of a scan while it is running.
+///
+/// Reset() means that all LEDs emitted so far are invalid and that the next LED has index 0 again. The detector
+/// calls it at the start of a scan and whenever it sees the all-on frame of the registration sequence.
+class ResultSink
+{
+public:
+    virtual ~ResultSink() {}
+
+    virtual void Led( const LedRecord &led) = 0;
+    virtual void Reset() = 0;
+
+    /// The scan has ended after emitting 'count' LEDs since the last reset.
+    virtual void Finish( std::size_t count) = 0;
+};
+
+/// Writes one JSON object per line, flushing after every line so that a reader on the other side of a pipe
+/// sees every LED as soon as it is found:
+///
+///     {"led":0,"frame":17,"time":566.667,"x":402.5,"y":133.25,"confidence":0.91}
+///     {"reset":true}
+///     {"end":true,"count":50}
+class JsonLinesSink : public ResultSink
+{
+public:
+    explicit JsonLinesSink( std::ostream &output)
+    : m_output( output)
+    {
+    }
+
+    void Led( const LedRecord &led) override
+    {
+        m_output << "{\"led\":" << led.index << ",\"frame\":" << led.frame << ",\"time\":" << led.time
+                 << ",\"x\":" << led.position.x << ",\"y\":" << led.position.y
+                 << ",\"confidence\":" << led.confidence << "}\n" << std::flush;
+    }
+
+    void Reset() override
+    {
+        m_output << "{\"reset\":true}\n" << std::flush;
+    }
+
+    void Finish( std::size_t count) override
+    {
+        m_output << "{\"end\":true,\"count\":" << count << "}\n" << std::flush;
+    }
+
+private:
+    std::ostream &m_output;
+};
+
+/// Writes a compact binary stream: the four bytes "LED1", followed by records that start with a type byte.
+///
+///     'L': uint32 index, int32 frame, float32 time (ms), float32 x, float32 y, float32 confidence (25 bytes)
+///     'R': reset (1 byte)
+///     'E': uint32 count (5 bytes)
+///
+/// All numbers are little-endian, independent of the host.
+class BinarySink : public ResultSink
+{
+public:
+    explicit BinarySink( std::ostream &output)
+    : m_output( output)
+    {
+        m_output.write( "LED1", 4);
+    }
+
+    void Led( const LedRecord &led) override
+    {
+        char record[25];
+        record[0] = 'L';
+        Put( record + 1, static_cast<std::uint32_t>( led.index));
+        Put( record + 5, static_cast<std::uint32_t>( static_cast<std::int32_t>( led.frame)));
+        Put( record + 9, static_cast<float>( led.time));
+        Put( record + 13, led.position.x);
+        Put( record + 17, led.position.y);
+        Put( record + 21, led.confidence);
+        m_output.write( record, sizeof record);
+        m_output.flush();
+    }
+
+    void Reset() override
+    {
+        m_output.put( 'R');
+        m_output.flush();
+    }
+
+    void Finish( std::size_t count) override
+    {
+        char record[5];
+        record[0] = 'E';
+        Put( record + 1, static_cast<std::uint32_t>( count));
+        m_output.write( record, sizeof record);
+        m_output.flush();
+    }
+
+private:
+    static void Put( char *buffer, std::uint32_t value)
+    {
+        for (int byte = 0; byte < 4; ++byte)
+        {
+            buffer[byte] = static_cast<char>( (value >> (8 * byte)) & 0xff);
+        }
+    }
+
+    static void Put( char *buffer, float value)
+    {
+        static_assert( sizeof( float) == sizeof( std::uint32_t), "float must be 32 bits");
+        std::uint32_t bits;
+        std::memcpy( &bits, &value, sizeof bits);
+        Put( buffer, bits);
+    }
+
+    std::ostream &m_output;
+};
+
+}
+#endif //RESULT_SINK_HPP_
@@ -0,0 +1,254 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * Micro benchmark for the Nelder-Mead solver: the original boost ublas points with a std::function cost function
+ * against std::array points with the exact type of the cost function (Solvers::MakeSolver()).
+ *
+ * Both variants run on a quadratic bowl and on the Rosenbrock function in 2 to 16 dimensions. The numbers of
+ * iterations and the final costs should be identical, only the evaluations per second should differ.
+ *
+ * The second table compares sequential against speculative parallel evaluation (NmSimplexSolver::SetPool()) for an
+ * artificially expensive cost function.
+ *
+ * The last table shows the number of cost evaluations with the standard and with the adaptive (Gao-Han)
+ * coefficients.
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "nm_simplex_solver.hpp"
+
+namespace
+{
+    /// sum of (i + 1) * (x_i - 1)^2, minimum 0 at (1, 1, ...)
+    struct Quadratic
+    {
+        static const char *Name()
+        {
+            return "quadratic";
+        }
+
+        template<typename Point>
+        double operator()( const Point &p) const
+        {
+            double sum = 0.0;
+            for (std::size_t i = 0; i < p.size(); ++i)
+            {
+                sum += (i + 1) * (p[i] - 1) * (p[i] - 1);
+            }
+            return sum;
+        }
+    };
+
+    /// the generalized Rosenbrock function, minimum 0 at (1, 1, ...)
+    struct Rosenbrock
+    {
+        static const char *Name()
+        {
+            return "rosenbrock";
+        }
+
+        template<typename Point>
+        double operator()( const Point &p) const
+        {
+            double sum = 0.0;
+            for (std::size_t i = 0; i + 1 < p.size(); ++i)
+            {
+                const double a = p[i + 1] - p[i] * p[i];
+                const double b = 1 - p[i];
+                sum += 100 * a * a + b * b;
+            }
+            return sum;
+        }
+    };
+
+    struct Result
+    {
+        double evaluationsPerSecond;
+        unsigned int iterations;
+        double cost;
+    };
+
+    /// Run the solver repeatedly for at least a fraction of a second.
+    template<typename Solver, typename Point>
+    Result Measure( Solver &solver, const Point &start, const unsigned long &evaluations)
+    {
+        const unsigned int maxIterations = 20000;
+        const auto begin = std::chrono::steady_clock::now();
+        std::chrono::duration<double> elapsed{ 0};
+        const unsigned long before = evaluations;
+        while (elapsed.count() < 0.25)
+        {
+            solver.FindMinimun( start, maxIterations);
+            elapsed = std::chrono::steady_clock::now() - begin;
+        }
+
+        return Result{ (evaluations - before) / elapsed.count(), solver.GetLastIterationCount(), solver.GetLastCostValue()};
+    }
+
+    template<int dimension, typename Function>
+    void Compare()
+    {
+        typedef Solvers::NmSimplexSolver<dimension> UblasSolver;
+        typedef typename Solvers::ArrayPoints<dimension>::Point ArrayPoint;
+
+        unsigned long ublasEvaluations = 0;
+        UblasSolver ublas{
+            [&ublasEvaluations]( const typename UblasSolver::Point &p) { ++ublasEvaluations; return Function()( p);},
+            0.5, 1e-12};
+
+        unsigned long arrayEvaluations = 0;
+        auto array = Solvers::MakeSolver<dimension>(
+            [&arrayEvaluations]( const ArrayPoint &p) { ++arrayEvaluations; return Function()( p);},
+            0.5, 1e-12);
+
+        // the classic starting point for Rosenbrock: (-1.2, 1, -1.2, 1, ...)
+        typename UblasSolver::Point ublasStart;
+        ArrayPoint arrayStart;
+        for (int i = 0; i < dimension; ++i)
+        {
+            ublasStart[i] = arrayStart[i] = i % 2 ? 1.0 : -1.2;
+        }
+
+        const Result a = Measure( ublas, ublasStart, ublasEvaluations);
+        const Result b = Measure( array, arrayStart, arrayEvaluations);
+
+        std::cout << std::left << std::setw( 12) << Function::Name() << std::right << std::setw( 5) << dimension
+                  << std::fixed << std::setprecision( 0)
+                  << std::setw( 14) << a.evaluationsPerSecond << std::setw( 14) << b.evaluationsPerSecond
+                  << std::setprecision( 2) << std::setw( 10) << b.evaluationsPerSecond / a.evaluationsPerSecond
+                  << std::setw( 8) << a.iterations << std::setw( 8) << b.iterations
+                  << std::scientific << std::setprecision( 2) << std::setw( 12) << a.cost << std::setw( 12) << b.cost
+                  << '\n';
+    }
+
+    /// A quadratic bowl that takes about 'microseconds' to evaluate, like a cost function on image data.
+    struct Expensive
+    {
+        template<typename Point>
+        double operator()( const Point &p) const
+        {
+            const auto end = std::chrono::steady_clock::now() + std::chrono::microseconds( microseconds);
+            while (std::chrono::steady_clock::now() < end) {}
+            return Quadratic()( p);
+        }
+
+        int microseconds;
+    };
+
+    /// Milliseconds per iteration with and without a pool for speculative evaluation.
+    template<int dimension>
+    void CompareSpeculative( Solvers::WorkStealingPool &pool)
+    {
+        typedef typename Solvers::ArrayPoints<dimension>::Point Point;
+        auto solver = Solvers::MakeSolver<dimension>( Expensive{ 20}, 0.5, 1e-6);
+        Point start;
+        start.fill( -1.2);
+
+        double milliseconds[2];
+        unsigned int iterations[2];
+        for (int parallel = 0; parallel < 2; ++parallel)
+        {
+            solver.SetPool( parallel ? &pool : nullptr);
+            const auto begin = std::chrono::steady_clock::now();
+            solver.FindMinimun( start, 200);
+            const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - begin;
+            iterations[parallel] = solver.GetLastIterationCount();
+            milliseconds[parallel] = elapsed.count() / iterations[parallel];
+        }
+
+        std::cout << std::left << std::setw( 12) << "expensive" << std::right << std::setw( 5) << dimension
+                  << std::fixed << std::setprecision( 3)
+                  << std::setw( 16) << milliseconds[0] << std::setw( 16) << milliseconds[1]
+                  << std::setprecision( 2) << std::setw( 10) << milliseconds[0] / milliseconds[1]
+                  << std::setw( 8) << iterations[0] << std::setw( 8) << iterations[1] << '\n';
+    }
+
+    /// Number of evaluations until convergence with standard and adaptive coefficients.
+    template<int dimension, typename Function>
+    void CompareCoefficients()
+    {
+        typedef typename Solvers::ArrayPoints<dimension>::Point Point;
+        auto solver = Solvers::MakeSolver<dimension>( Function(), 0.5, 1e-12);
+        Point start;
+        for (int i = 0; i < dimension; ++i)
+        {
+            start[i] = i % 2 ? 1.0 : -1.2;
+        }
+
+        unsigned int evaluations[2];
+        double costs[2];
+        for (int adaptive = 0; adaptive < 2; ++adaptive)
+        {
+            solver.SetCoefficients( adaptive ?
+                    Solvers::Coefficients::Adaptive( dimension) : Solvers::Coefficients::Standard());
+            solver.FindMinimun( start, 100000);
+            evaluations[adaptive] = solver.GetStats().TotalEvaluations();
+            costs[adaptive] = solver.GetLastCostValue();
+        }
+
+        std::cout << std::left << std::setw( 12) << Function::Name() << std::right << std::setw( 5) << dimension
+                  << std::setw( 14) << evaluations[0] << std::setw( 14) << evaluations[1]
+                  << std::scientific << std::setprecision( 2) << std::setw( 12) << costs[0] << std::setw( 12) << costs[1]
+                  << '\n';
+    }
+
+    template<typename Function>
+    void CompareAllCoefficients()
+    {
+        CompareCoefficients<2, Function>();
+        CompareCoefficients<4, Function>();
+        CompareCoefficients<8, Function>();
+        CompareCoefficients<16, Function>();
+    }
+
+    template<typename Function>
+    void CompareAll()
+    {
+        Compare<2, Function>();
+        Compare<4, Function>();
+        Compare<8, Function>();
+        Compare<16, Function>();
+    }
+}
+
+int main()
+{
+    std::cout << std::left << std::setw( 12) << "function" << std::right << std::setw( 5) << "dim"
+              << std::setw( 14) << "ublas (ev/s)" << std::setw( 14) << "array (ev/s)" << std::setw( 10) << "speedup"
+              << std::setw( 8) << "it A" << std::setw( 8) << "it B"
+              << std::setw( 12) << "cost A" << std::setw( 12) << "cost B" << '\n';
+
+    CompareAll<Quadratic>();
+    CompareAll<Rosenbrock>();
+
+    Solvers::WorkStealingPool pool{ std::max( 4u, std::thread::hardware_concurrency())};
+    std::cout << '\n' << std::left << std::setw( 12) << "function" << std::right << std::setw( 5) << "dim"
+              << std::setw( 16) << "serial (ms/it)" << std::setw( 16) << "spec. (ms/it)" << std::setw( 10) << "speedup"
+              << std::setw( 8) << "it A" << std::setw( 8) << "it B" << '\n';
+    CompareSpeculative<2>( pool);
+    CompareSpeculative<4>( pool);
+    CompareSpeculative<8>( pool);
+    std::cout << "Speculative evaluation is off by default (NmSimplexSolver::SetPool()), it computes up to four candidate\n"
+              << "points per iteration where serial evaluation needs one or two, so it only pays off with several cores.\n"
+              << "This machine has " << std::thread::hardware_concurrency() << " hardware threads.\n";
+
+    std::cout << '\n' << std::left << std::setw( 12) << "function" << std::right << std::setw( 5) << "dim"
+              << std::setw( 14) << "standard (ev)" << std::setw( 14) << "adaptive (ev)"
+              << std::setw( 12) << "cost A" << std::setw( 12) << "cost B" << '\n';
+    CompareAllCoefficients<Quadratic>();
+    CompareAllCoefficients<Rosenbrock>();
+
+    return 0;
+}
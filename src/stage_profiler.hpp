@@ -0,0 +1,302 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( STAGE_PROFILER_HPP_)
+#define STAGE_PROFILER_HPP_
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <limits>
+#include <ostream>
+
+namespace Detection
+{
+
+/// The stages of the per-frame analysis that are timed separately.
+enum Stage
+{
+    DecodeStage,        ///< reading (or grabbing) frames from the video
+    DifferenceStage,    ///< the channel difference of two frames
+    BlurStage,          ///< GaussianBlur
+    ThresholdStage,     ///< inRange
+    BlobStage,          ///< finding and filtering blobs, including the pyramid search
+    BookkeepingStage,   ///< caches, memos, patches and the list of found LEDs
+    StageCount
+};
+
+/// Events that are counted during a scan.
+enum Counter
+{
+    FrameCounter,       ///< frames read or grabbed
+    DetectionCounter,   ///< LEDs that were added to the results
+    SkipCounter,        ///< frames that were not analysed
+    ResetCounter,       ///< times that the results were cleared because many LEDs were lit
+    CounterCount
+};
+
+inline const char *StageName( int stage)
+{
+    static const char *names[StageCount] = { "decode", "difference", "blur", "inRange", "blobs", "bookkeeping"};
+    return names[stage];
+}
+
+inline const char *CounterName( int counter)
+{
+    static const char *names[CounterCount] = { "frames", "detections", "skipped", "resets"};
+    return names[counter];
+}
+
+/// Latency histograms per stage and event counters.
+///
+/// Every stage keeps the number of samples, their total, minimum and maximum, and a histogram with power-of-two
+/// buckets: bucket b counts the samples of at least 2^b and less than 2^(b+1) nanoseconds. Adding a sample costs a
+/// handful of instructions, the two clock reads around a stage are the main overhead.
+///
+/// A profiler is not thread-safe, threads should each use their own and Merge() them afterwards.
+class StageProfiler
+{
+public:
+    static const int BucketCount = 40;
+
+    typedef std::chrono::steady_clock Clock;
+
+    /// Times a stage from construction to destruction.
+    class Scope
+    {
+    public:
+        Scope( StageProfiler &profiler, Stage stage)
+        : m_profiler( profiler), m_stage( stage), m_start( Clock::now())
+        {
+        }
+
+        ~Scope()
+        {
+            m_profiler.Add( m_stage, Clock::now() - m_start);
+        }
+
+    private:
+        StageProfiler &m_profiler;
+        Stage m_stage;
+        Clock::time_point m_start;
+    };
+
+    static bool IsEnabled()
+    {
+        return true;
+    }
+
+    void Reset()
+    {
+        *this = StageProfiler();
+    }
+
+    void Add( Stage stage, Clock::duration duration)
+    {
+        const std::uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>( duration).count();
+        auto &histogram = m_stages[stage];
+        ++histogram.count;
+        histogram.total += nanoseconds;
+        histogram.min = std::min( histogram.min, nanoseconds);
+        histogram.max = std::max( histogram.max, nanoseconds);
+        ++histogram.buckets[Bucket( nanoseconds)];
+    }
+
+    void Count( Counter counter, std::uint64_t count = 1)
+    {
+        m_counters[counter] += count;
+    }
+
+    void Merge( const StageProfiler &other)
+    {
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            auto &histogram = m_stages[stage];
+            const auto &source = other.m_stages[stage];
+            histogram.count += source.count;
+            histogram.total += source.total;
+            histogram.min = std::min( histogram.min, source.min);
+            histogram.max = std::max( histogram.max, source.max);
+            for (int bucket = 0; bucket < BucketCount; ++bucket)
+            {
+                histogram.buckets[bucket] += source.buckets[bucket];
+            }
+        }
+        for (int counter = 0; counter < CounterCount; ++counter)
+        {
+            m_counters[counter] += other.m_counters[counter];
+        }
+    }
+
+    std::uint64_t GetCount( Counter counter) const
+    {
+        return m_counters[counter];
+    }
+
+    /// A human readable table, times in microseconds. Percentiles are the upper bounds of histogram buckets.
+    void Print( std::ostream &output) const
+    {
+        output << std::left << std::setw( 12) << "stage" << std::right
+               << std::setw( 10) << "count" << std::setw( 12) << "total (ms)" << std::setw( 10) << "mean (us)"
+               << std::setw( 10) << "min (us)" << std::setw( 10) << "p50 (us)" << std::setw( 10) << "p99 (us)"
+               << std::setw( 10) << "max (us)" << '\n';
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            const auto &histogram = m_stages[stage];
+            output << std::left << std::setw( 12) << StageName( stage) << std::right << std::fixed << std::setprecision( 1)
+                   << std::setw( 10) << histogram.count
+                   << std::setw( 12) << histogram.total / 1e6
+                   << std::setw( 10) << histogram.Mean() / 1e3
+                   << std::setw( 10) << histogram.Min() / 1e3
+                   << std::setw( 10) << histogram.Percentile( 0.5) / 1e3
+                   << std::setw( 10) << histogram.Percentile( 0.99) / 1e3
+                   << std::setw( 10) << histogram.max / 1e3 << '\n';
+        }
+        for (int counter = 0; counter < CounterCount; ++counter)
+        {
+            output << std::left << std::setw( 12) << CounterName( counter) << std::right
+                   << std::setw( 10) << m_counters[counter] << '\n';
+        }
+    }
+
+    /// All numbers, including the histograms, as a JSON object. Times are in nanoseconds.
+    void WriteJson( std::ostream &output) const
+    {
+        output << "{\n  \"stages\": {\n";
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            const auto &histogram = m_stages[stage];
+            output << "    \"" << StageName( stage) << "\": { \"count\": " << histogram.count
+                   << ", \"total\": " << histogram.total << ", \"min\": " << histogram.Min()
+                   << ", \"max\": " << histogram.max << ", \"buckets\": [";
+            for (int bucket = 0; bucket < BucketCount; ++bucket)
+            {
+                output << (bucket ? ", " : "") << histogram.buckets[bucket];
+            }
+            output << "]}" << (stage + 1 < StageCount ? "," : "") << '\n';
+        }
+        output << "  },\n  \"counters\": {";
+        for (int counter = 0; counter < CounterCount; ++counter)
+        {
+            output << (counter ? ", " : " ") << '"' << CounterName( counter) << "\": " << m_counters[counter];
+        }
+        output << "}\n}\n";
+    }
+
+    /// One line per stage and per counter. Times are in nanoseconds, bucket b holds samples in [2^b, 2^(b+1)).
+    void WriteCsv( std::ostream &output) const
+    {
+        output << "name,count,total,min,max";
+        for (int bucket = 0; bucket < BucketCount; ++bucket)
+        {
+            output << ",b" << bucket;
+        }
+        output << '\n';
+
+        for (int stage = 0; stage < StageCount; ++stage)
+        {
+            const auto &histogram = m_stages[stage];
+            output << StageName( stage) << ',' << histogram.count << ',' << histogram.total << ','
+                   << histogram.Min() << ',' << histogram.max;
+            for (int bucket = 0; bucket < BucketCount; ++bucket)
+            {
+                output << ',' << histogram.buckets[bucket];
+            }
+            output << '\n';
+        }
+        for (int counter = 0; counter < CounterCount; ++counter)
+        {
+            output << CounterName( counter) << ',' << m_counters[counter] << ",,,\n";
+        }
+    }
+
+private:
+    struct Histogram
+    {
+        std::uint64_t count = 0;
+        std::uint64_t total = 0;
+        std::uint64_t min = std::numeric_limits<std::uint64_t>::max();
+        std::uint64_t max = 0;
+        std::uint64_t buckets[BucketCount] = {};
+
+        double Mean() const
+        {
+            return count ? static_cast<double>( total) / count : 0.0;
+        }
+
+        std::uint64_t Min() const
+        {
+            return count ? min : 0;
+        }
+
+        /// Upper bound of the bucket that contains the given fraction of the samples, clamped to the maximum.
+        double Percentile( double fraction) const
+        {
+            std::uint64_t seen = 0;
+            for (int bucket = 0; bucket < BucketCount; ++bucket)
+            {
+                seen += buckets[bucket];
+                if (seen && seen >= fraction * count)
+                {
+                    return static_cast<double>( std::min( std::uint64_t( 2) << bucket, max));
+                }
+            }
+            return static_cast<double>( max);
+        }
+    };
+
+    static int Bucket( std::uint64_t nanoseconds)
+    {
+        int bucket = 0;
+        while (nanoseconds > 1 && bucket < BucketCount - 1)
+        {
+            nanoseconds >>= 1;
+            ++bucket;
+        }
+        return bucket;
+    }
+
+    Histogram m_stages[StageCount];
+    std::uint64_t m_counters[CounterCount] = {};
+};
+
+/// A profiler with the same interface that does nothing, so that every call to it compiles away.
+class NullProfiler
+{
+public:
+    class Scope
+    {
+    public:
+        Scope( NullProfiler &, Stage)
+        {
+        }
+    };
+
+    static bool IsEnabled()
+    {
+        return false;
+    }
+
+    void Reset() {}
+    void Count( Counter, std::uint64_t = 1) {}
+    void Merge( const NullProfiler &) {}
+    std::uint64_t GetCount( Counter) const { return 0;}
+    void Print( std::ostream &) const {}
+    void WriteJson( std::ostream &) const {}
+    void WriteCsv( std::ostream &) const {}
+};
+
+/// Profiling is compiled in only if LED_PROFILING is defined (cmake -DLED_PROFILING=ON).
+#if defined( LED_PROFILING)
+typedef StageProfiler Profiler;
+#else
+typedef NullProfiler Profiler;
+#endif
+
+}
+#endif //STAGE_PROFILER_HPP_
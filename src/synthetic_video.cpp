@@ -0,0 +1,96 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+/**
+ * Create a video of one of the registration sequences of the AVR code, with the true LED positions in a separate
+ * file, so that LedMapping can be tested and benchmarked without a camera and an LED string.
+ */
+
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <opencv2/core/core.hpp>
+
+#include "synthetic_video.hpp"
+
+using namespace cv;
+
+int main( int argc, char **argv)
+{
+    const std::string keys =
+            "{help h usage ? |       | print this message}"
+            "{@video         |       | video file to create (.avi)}"
+            "{truth          |       | file for the true LED positions (default: video file name + .csv)}"
+            "{sequence q     |simple | registration sequence: simple, color, binary or registration}"
+            "{width          |1280   | width of the video in pixels}"
+            "{height         |720    | height of the video in pixels}"
+            "{leds           |50     | number of LEDs}"
+            "{fps            |30     | frames per second}"
+            "{radius         |6      | radius of an LED in pixels}"
+            "{blur           |2      | sigma of the optical blur in pixels}"
+            "{noise          |3      | standard deviation of the sensor noise}"
+            "{brightness     |220    | brightness of a lit LED (0-255)}"
+            "{repeat         |1      | number of passes of the sequence, 2 seconds apart}"
+            "{seed           |1      | seed for the LED positions and the noise}";
+
+    CommandLineParser parser{ argc, argv, keys};
+    parser.about( "Create a synthetic video of an LED registration sequence.");
+
+    const auto video = parser.get<std::string>( "@video");
+    if (parser.has( "help") || video.empty() || !parser.check())
+    {
+        parser.printErrors();
+        parser.printMessage();
+        return -1;
+    }
+
+    try
+    {
+        Detection::SyntheticVideo::Options options;
+        if (!Detection::SyntheticVideo::ParseSequence( parser.get<std::string>( "sequence"), options.sequence))
+        {
+            throw std::runtime_error( "Unknown sequence type " + parser.get<std::string>( "sequence"));
+        }
+        options.resolution = Size{ parser.get<int>( "width"), parser.get<int>( "height")};
+        options.ledCount = parser.get<int>( "leds");
+        options.fps = parser.get<double>( "fps");
+        options.ledRadius = parser.get<int>( "radius");
+        options.blur = parser.get<double>( "blur");
+        options.noise = parser.get<double>( "noise");
+        options.brightness = parser.get<int>( "brightness");
+        options.repeat = parser.get<int>( "repeat");
+        options.seed = parser.get<unsigned int>( "seed");
+
+        const Detection::SyntheticVideo synthetic{ options};
+        synthetic.Write( video);
+
+        const std::string truthName = parser.has( "truth") ? parser.get<std::string>( "truth") : video + ".csv";
+        std::ofstream truth{ truthName};
+        if (!truth)
+        {
+            throw std::runtime_error( "Can't open output file " + truthName);
+        }
+        synthetic.WriteTruth( truth);
+
+        std::cout << "Wrote " << synthetic.FrameCount() << " frames to " << video
+                  << " and " << options.ledCount << " LED positions to " << truthName << '\n';
+    }
+    catch( cv::Exception& e )
+    {
+        std::cerr << "OpenCV exception: " << e.what() << std::endl;
+        return -1;
+    }
+    catch( std::exception& e )
+    {
+        std::cerr << e.what() << std::endl;
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,325 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( SYNTHETIC_VIDEO_HPP_)
+#define SYNTHETIC_VIDEO_HPP_
+#include <algorithm>
+#include <cmath>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/core/core.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/videoio/videoio.hpp>
+
+namespace Detection
+{
+
+/// A synthetic video of an LED string that shows one of the registration sequences of the AVR code, with
+/// known LED positions.
+///
+/// The LEDs are placed at random (but reproducible) positions, the timing of the sequences is that of the AVR code.
+/// Every frame shows the state of the LEDs at the start of that frame, optically blurred, on a dim background with
+/// sensor noise.
+class SyntheticVideo
+{
+public:
+    enum Sequence
+    {
+        Simple,         ///< simple_registration(): the LEDs one by one
+        Color,          ///< color_registration(): three LEDs at a time in red, green and blue
+        Binary,         ///< binary_pattern(): all LEDs, red or blue according to one bit of their index
+        Registration    ///< registration_pattern(): all LEDs alternating red and blue
+    };
+
+    struct Options
+    {
+        cv::Size    resolution{ 1280, 720};
+        int         ledCount = 50;
+        double      fps = 30.0;
+        int         ledRadius = 6;      ///< radius in pixels of a lit LED, before blurring
+        double      blur = 2.0;         ///< sigma in pixels of the optical blur
+        double      noise = 3.0;        ///< standard deviation of the sensor noise in grey levels
+        int         brightness = 220;   ///< grey level of a lit LED
+        Sequence    sequence = Simple;
+        int         repeat = 1;         ///< number of passes of the sequence, 2 seconds apart like in the AVR code
+        unsigned int seed = 1;
+    };
+
+    explicit SyntheticVideo( const Options &options)
+    : m_options( options)
+    {
+        PlaceLeds();
+        CreateBackground();
+        CreateTimeline();
+    }
+
+    static bool ParseSequence( const std::string &name, Sequence &sequence)
+    {
+        static const char *names[] = { "simple", "color", "binary", "registration"};
+        for (int index = 0; index < 4; ++index)
+        {
+            if (name == names[index])
+            {
+                sequence = static_cast<Sequence>( index);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const Options &GetOptions() const
+    {
+        return m_options;
+    }
+
+    /// The true position of every LED, in LED index order.
+    const std::vector<cv::Point2f> &Positions() const
+    {
+        return m_positions;
+    }
+
+    int FrameCount() const
+    {
+        return static_cast<int>( std::ceil( m_timeline.back().end * m_options.fps / 1000.0));
+    }
+
+    /// Render frame 'frame' into a BGR image.
+    void Render( int frame, cv::Mat &image) const
+    {
+        const double time = frame * 1000.0 / m_options.fps;
+        const Segment &segment = At( time);
+
+        cv::Mat leds = cv::Mat::zeros( m_options.resolution, CV_8UC3);
+        const int shift = 4; // sub-pixel positions with 4 fractional bits
+        for (int led = 0; led < m_options.ledCount; ++led)
+        {
+            cv::Scalar color;
+            if (!LedColor( segment, led, color)) continue;
+            const cv::Point center{ cvRound( m_positions[led].x * (1 << shift)), cvRound( m_positions[led].y * (1 << shift))};
+            cv::circle( leds, center, m_options.ledRadius << shift, color, cv::FILLED, cv::LINE_AA, shift);
+        }
+        if (m_options.blur > 0)
+        {
+            cv::GaussianBlur( leds, leds, cv::Size(), m_options.blur);
+        }
+
+        cv::Mat noise{ m_options.resolution, CV_16SC3};
+        cv::RNG rng{ m_options.seed * 7919u + static_cast<unsigned int>( frame)};
+        rng.fill( noise, cv::RNG::NORMAL, cv::Scalar::all( 0), cv::Scalar::all( m_options.noise));
+
+        cv::Mat sum;
+        cv::add( m_background, leds, sum, cv::noArray(), CV_16SC3);
+        cv::add( sum, noise, sum);
+        sum.convertTo( image, CV_8UC3);
+    }
+
+    /// Write the complete sequence to a (MJPG) video file.
+    void Write( const std::string &fileName) const
+    {
+        cv::VideoWriter writer{ fileName, cv::VideoWriter::fourcc( 'M', 'J', 'P', 'G'), m_options.fps, m_options.resolution};
+        if (!writer.isOpened())
+        {
+            throw std::runtime_error( "Can't create video file " + fileName);
+        }
+
+        cv::Mat frame;
+        const int frames = FrameCount();
+        for (int index = 0; index < frames; ++index)
+        {
+            Render( index, frame);
+            writer.write( frame);
+        }
+    }
+
+    /// Write the ground truth as "index,x,y" lines.
+    void WriteTruth( std::ostream &output) const
+    {
+        output << "# index,x,y\n";
+        for (std::size_t led = 0; led < m_positions.size(); ++led)
+        {
+            output << led << ',' << m_positions[led].x << ',' << m_positions[led].y << '\n';
+        }
+    }
+
+private:
+    /// A period of time in which the LEDs show one pattern.
+    struct Segment
+    {
+        enum Kind { Dark, All, One, Three, Bits};
+
+        double      start;  ///< in ms
+        double      end;
+        Kind        kind;
+        int         parameter; ///< the LED for One, the first LED for Three, the block size for Bits
+        cv::Scalar  color;     ///< for All and One
+    };
+
+    /// LEDs at random positions, at least four radii apart and away from the edges.
+    void PlaceLeds()
+    {
+        cv::RNG rng{ m_options.seed};
+        const int margin = 4 * m_options.ledRadius;
+        const float minDistance = 4.0f * m_options.ledRadius;
+        const cv::Size size = m_options.resolution;
+        CV_Assert( size.width > 2 * margin && size.height > 2 * margin);
+
+        for (int led = 0; led < m_options.ledCount; ++led)
+        {
+            cv::Point2f candidate;
+            bool fits = false;
+            for (int attempt = 0; attempt < 1000 && !fits; ++attempt)
+            {
+                candidate = cv::Point2f(
+                        static_cast<float>( rng.uniform( double( margin), double( size.width - margin))),
+                        static_cast<float>( rng.uniform( double( margin), double( size.height - margin))));
+                fits = std::none_of( m_positions.begin(), m_positions.end(),
+                        [&]( const cv::Point2f &other) { return cv::norm( other - candidate) < minDistance;});
+            }
+            if (!fits)
+            {
+                throw std::runtime_error( "Can't fit that many LEDs in the frame");
+            }
+            m_positions.push_back( candidate);
+        }
+    }
+
+    /// A dim gradient with some fixed texture, so that the difference of two frames is not trivially zero.
+    void CreateBackground()
+    {
+        const cv::Size size = m_options.resolution;
+        m_background.create( size, CV_8UC3);
+        cv::RNG rng{ m_options.seed + 1};
+        for (int y = 0; y < size.height; ++y)
+        {
+            cv::Vec3b *row = m_background.ptr<cv::Vec3b>( y);
+            for (int x = 0; x < size.width; ++x)
+            {
+                const int level = 10 + 20 * x / size.width + 10 * y / size.height + rng.uniform( 0, 6);
+                row[x] = cv::Vec3b( level, level, level + 2);
+            }
+        }
+    }
+
+    void Add( double duration, Segment::Kind kind, int parameter = 0, const cv::Scalar &color = cv::Scalar())
+    {
+        const double start = m_timeline.empty() ? 0.0 : m_timeline.back().end;
+        m_timeline.push_back( Segment{ start, start + duration, kind, parameter, color});
+    }
+
+    /// The timing of the sequences of avr/LedMapping/LedMapping.cpp, with half a second of darkness
+    /// before and after.
+    void CreateTimeline()
+    {
+        Add( 500, Segment::Dark);
+        for (int pass = 0; pass < m_options.repeat; ++pass)
+        {
+            if (pass) Add( 2000, Segment::Dark);
+            AddSequence();
+        }
+        Add( 500, Segment::Dark);
+    }
+
+    /// One pass of the sequence.
+    void AddSequence()
+    {
+        const double frame = 100.0;
+        const int level = m_options.brightness;
+        const cv::Scalar red{ 0, 0, double( level)};
+        const cv::Scalar blue{ double( level), 0, 0};
+
+        switch (m_options.sequence)
+        {
+        case Simple:
+            Add( 2 * frame, Segment::All, 0, red);
+            Add( 2 * frame, Segment::Dark);
+            for (int led = 0; led < m_options.ledCount; ++led)
+            {
+                Add( frame, Segment::One, led, red);
+                Add( frame, Segment::Dark);
+            }
+            break;
+
+        case Color:
+            Add( 2 * frame, Segment::All, 0, cv::Scalar::all( level));
+            Add( 2 * frame, Segment::Dark);
+            for (int led = 0; led < m_options.ledCount; led += 3)
+            {
+                Add( frame, Segment::Three, led);
+                Add( frame, Segment::Dark);
+            }
+            break;
+
+        case Binary:
+        {
+            int power = 1;
+            while (power < m_options.ledCount) power *= 2;
+            for (int block = power / 2; block; block /= 2)
+            {
+                Add( frame, Segment::Bits, block);
+                Add( frame, Segment::Dark);
+            }
+            break;
+        }
+
+        case Registration:
+            for (int count = 0; count < 4; ++count)
+            {
+                Add( 2000, Segment::All, 0, red);
+                Add( 2000, Segment::All, 0, blue);
+            }
+            break;
+        }
+    }
+
+    const Segment &At( double time) const
+    {
+        const auto segment = std::upper_bound( m_timeline.begin(), m_timeline.end(), time,
+                []( double t, const Segment &s) { return t < s.end;});
+        return segment == m_timeline.end() ? m_timeline.back() : *segment;
+    }
+
+    /// The colour of an LED during a segment. Returns false if the LED is off.
+    bool LedColor( const Segment &segment, int led, cv::Scalar &color) const
+    {
+        const double level = m_options.brightness;
+        switch (segment.kind)
+        {
+        case Segment::All:
+            color = segment.color;
+            return true;
+        case Segment::One:
+            color = segment.color;
+            return led == segment.parameter;
+        case Segment::Three:
+        {
+            // red, green and blue, in BGR order.
+            const int offset = led - segment.parameter;
+            if (offset < 0 || offset > 2) return false;
+            color = cv::Scalar();
+            color[2 - offset] = level;
+            return true;
+        }
+        case Segment::Bits:
+            color = (led / segment.parameter) % 2 ? cv::Scalar( level, 0, 0) : cv::Scalar( 0, 0, level);
+            return true;
+        case Segment::Dark:
+        default:
+            return false;
+        }
+    }
+
+    Options                 m_options;
+    std::vector<cv::Point2f> m_positions;
+    std::vector<Segment>    m_timeline;
+    cv::Mat                 m_background;
+};
+
+}
+#endif //SYNTHETIC_VIDEO_HPP_
@@ -0,0 +1,189 @@
+//
+//  Copyright (C) 2016 Danny Havenith
+//
+//  Distributed under the Boost Software License, Version 1.0. (See
+//  accompanying file LICENSE_1_0.txt or copy at
+//  http://www.boost.org/LICENSE_1_0.txt)
+//
+
+#if !defined( WORK_STEALING_POOL_HPP_)
+#define WORK_STEALING_POOL_HPP_
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Solvers
+{
+
+/// A fixed set of threads that run the items of a batch in parallel.
+///
+/// Every thread gets a contiguous share of the items of a batch in its own queue and takes them from the front.
+/// A thread that runs out of work steals items from the back of the queue of another thread, so that a few
+/// expensive items do not leave the other threads idle.
+/// The calling thread of ForEach() takes part in the work, so a pool of n threads starts n - 1 threads.
+class WorkStealingPool
+{
+public:
+    explicit WorkStealingPool(unsigned int threads = std::thread::hardware_concurrency()) :
+            queues(threads ? threads : 1)
+    {
+        for (auto &queue : queues)
+        {
+            queue.reset(new Queue);
+        }
+        for (unsigned int thread = 1; thread < queues.size(); ++thread)
+        {
+            workers.emplace_back([this, thread]()
+            {   Run(thread);});
+        }
+    }
+
+    ~WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+        }
+        start.notify_all();
+        for (auto &worker : workers)
+        {
+            worker.join();
+        }
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    unsigned int GetThreadCount() const
+    {
+        return static_cast<unsigned int>(queues.size());
+    }
+
+    /// Call task(i) for all i in [0, count) and wait until all calls have finished.
+    /// If any of the calls throws, the first exception is rethrown here after all threads have stopped.
+    /// Only one batch can run at a time, ForEach() must not be called from within a task.
+    template<typename Task>
+    void ForEach(std::size_t count, const Task &task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            const std::size_t threads = queues.size();
+            for (std::size_t thread = 0; thread < threads; ++thread)
+            {
+                std::lock_guard<std::mutex> queueLock(queues[thread]->mutex);
+                for (std::size_t item = count * thread / threads;
+                        item < count * (thread + 1) / threads; ++item)
+                {
+                    queues[thread]->items.push_back(item);
+                }
+            }
+            current = task;
+            error = nullptr;
+            busy = workers.size();
+            ++generation;
+        }
+        start.notify_all();
+
+        Work(0);
+
+        std::unique_lock<std::mutex> lock(mutex);
+        done.wait(lock, [this]()
+        {   return busy == 0;});
+        current = nullptr;
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<std::size_t> items;
+    };
+
+    void Run(unsigned int self)
+    {
+        unsigned int seen = 0;
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                start.wait(lock, [this, seen]()
+                {   return stop || generation != seen;});
+                if (stop) return;
+                seen = generation;
+            }
+
+            Work(self);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--busy == 0)
+            {
+                done.notify_all();
+            }
+        }
+    }
+
+    void Work(unsigned int self)
+    {
+        std::size_t item;
+        while (Next(self, item))
+        {
+            try
+            {
+                current(item);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) error = std::current_exception();
+            }
+        }
+    }
+
+    /// Take the next item from our own queue or, if that is empty, steal one from another thread.
+    bool Next(unsigned int self, std::size_t &item)
+    {
+        for (std::size_t offset = 0; offset < queues.size(); ++offset)
+        {
+            Queue &queue = *queues[(self + offset) % queues.size()];
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (!queue.items.empty())
+            {
+                if (offset == 0)
+                {
+                    item = queue.items.front();
+                    queue.items.pop_front();
+                }
+                else
+                {
+                    item = queue.items.back();
+                    queue.items.pop_back();
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::vector<std::unique_ptr<Queue> > queues;
+    std::vector<std::thread> workers;
+    std::function<void(std::size_t)> current;
+    std::exception_ptr error;
+    std::mutex mutex;
+    std::condition_variable start;
+    std::condition_variable done;
+    unsigned int generation = 0;
+    std::size_t busy = 0;
+    bool stop = false;
+};
+}
+#endif //WORK_STEALING_POOL_HPP_